@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include <common/shader.hpp>
+#include <common/antialiasing.hpp>
+
+AntiAliasing::AntiAliasing(const int width, const int height)
+{
+    this->width = width;
+    this->height = height;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+
+    // Programs
+    fxaaShaderID = LoadShaders("fullscreenVertexShader.glsl", "fxaaFragmentShader.glsl");
+    edgeShaderID = LoadShaders("fullscreenVertexShader.glsl", "smaaEdgeFragmentShader.glsl");
+    weightShaderID = LoadShaders("fullscreenVertexShader.glsl", "smaaWeightFragmentShader.glsl");
+    blendShaderID = LoadShaders("fullscreenVertexShader.glsl", "smaaBlendFragmentShader.glsl");
+
+    glGenVertexArrays(1, &emptyVAO);
+    glGenQueries(2 * numQueries, &queries[0][0]);
+}
+
+TargetDesc AntiAliasing::sceneDesc(const AntiAliasingMode mode) const
+{
+    int samples = 0;
+    if (mode == AAMSAA2 || mode == AAMSAA4 || mode == AAMSAA8)
+        samples = std::min(mode == AAMSAA2 ? 2 : mode == AAMSAA4 ? 4 : 8, maxSamples);
+    return TargetDesc(width, height, TargetRGBA8, samples);
+}
+
+void AntiAliasing::addPasses(RenderGraph &graph, RenderTargetPool &pool, const AntiAliasingMode mode,
+                             const unsigned int scene, const unsigned int output)
+{
+    if (mode != this->mode)
+    {
+        this->mode = mode;
+        queryFrame = 0;
+        resolveMilliseconds = 0.0f;
+    }
+    if (mode == AAOff)
+        return;
+
+    RenderTargetPool *targets = &pool;
+    if (mode == AAFXAA || mode == AASMAA)
+    {
+        unsigned int pass;
+        if (mode == AAFXAA)
+        {
+            pass = graph.addPass("FXAA", [=]()
+            {
+                beginTiming();
+                glUseProgram(fxaaShaderID);
+                glUniform2f(glGetUniformLocation(fxaaShaderID, "inverseSize"), 1.0f / width, 1.0f / height);
+                drawFullscreen(fxaaShaderID, targets->texture(scene), targets->framebuffer(output));
+                endTiming();
+            });
+        }
+        else
+        {
+            // Pixels without edges are discarded by the edge pass and skip the weight search, so
+            // both targets are cleared to zero whatever clear colour the scene pass left behind
+            unsigned int edges = graph.create("SMAA edges", TargetDesc(width, height, TargetRG8));
+            unsigned int weights = graph.create("SMAA weights", TargetDesc(width, height, TargetRGBA8));
+            pass = graph.addPass("SMAA edges", [=]()
+            {
+                beginTiming();
+                glBindFramebuffer(GL_FRAMEBUFFER, targets->framebuffer(edges));
+                glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+                drawFullscreen(edgeShaderID, targets->texture(scene), targets->framebuffer(edges));
+            });
+            graph.read(pass, scene);
+            graph.write(pass, edges);
+            pass = graph.addPass("SMAA weights", [=]()
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, targets->framebuffer(weights));
+                glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+                drawFullscreen(weightShaderID, targets->texture(edges), targets->framebuffer(weights));
+            });
+            graph.read(pass, edges);
+            graph.write(pass, weights);
+            pass = graph.addPass("SMAA blend", [=]()
+            {
+                glUseProgram(blendShaderID);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, targets->texture(weights));
+                glUniform1i(glGetUniformLocation(blendShaderID, "weights"), 1);
+                drawFullscreen(blendShaderID, targets->texture(scene), targets->framebuffer(output));
+                endTiming();
+            });
+            graph.read(pass, weights);
+        }
+        graph.read(pass, scene);
+        graph.write(pass, output);
+        return;
+    }
+
+    // Multisampled scenes resolve with a blit
+    unsigned int pass = graph.addPass("MSAA resolve", [=]()
+    {
+        beginTiming();
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, targets->framebuffer(scene));
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targets->framebuffer(output));
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        endTiming();
+    });
+    graph.read(pass, scene);
+    graph.write(pass, output);
+}
+
+void AntiAliasing::beginTiming()
+{
+    // Read back the timestamps written numQueries frames ago before reusing them
+    unsigned int *timestamps = queries[queryFrame % numQueries];
+    if (queryFrame >= numQueries)
+    {
+        int available = 0;
+        glGetQueryObjectiv(timestamps[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(timestamps[0], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(timestamps[1], GL_QUERY_RESULT, &end);
+            resolveMilliseconds = (end - begin) / 1.0e6f;
+        }
+    }
+    glQueryCounter(timestamps[0], GL_TIMESTAMP);
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(emptyVAO);
+}
+
+void AntiAliasing::endTiming()
+{
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+    glQueryCounter(queries[queryFrame % numQueries][1], GL_TIMESTAMP);
+    queryFrame++;
+}
+
+void AntiAliasing::drawFullscreen(const unsigned int shaderID, const unsigned int texture, const unsigned int framebuffer)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    glUseProgram(shaderID);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniform1i(glGetUniformLocation(shaderID, "image"), 0);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+const char *AntiAliasing::name(const AntiAliasingMode mode)
+{
+    static const char *names[numAntiAliasingModes] = { "off", "MSAA 2x", "MSAA 4x", "MSAA 8x", "FXAA", "SMAA 1x" };
+    return names[mode];
+}
+
+void AntiAliasing::deleteBuffers()
+{
+    glDeleteQueries(2 * numQueries, &queries[0][0]);
+    glDeleteVertexArrays(1, &emptyVAO);
+    glDeleteProgram(fxaaShaderID);
+    glDeleteProgram(edgeShaderID);
+    glDeleteProgram(weightShaderID);
+    glDeleteProgram(blendShaderID);
+}
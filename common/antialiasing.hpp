@@ -0,0 +1,76 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <common/rendergraph.hpp>
+#include <common/rendertargets.hpp>
+
+// Anti-aliasing modes, the default framebuffer is single sampled and every
+// mode except AAOff draws the scene offscreen first
+enum AntiAliasingMode
+{
+    AAOff = 0,
+    AAMSAA2 = 1,
+    AAMSAA4 = 2,
+    AAMSAA8 = 3,
+    AAFXAA = 4,
+    AASMAA = 5,
+    numAntiAliasingModes = 6
+};
+
+// Anti-aliasing stage between the scene and the default framebuffer, added
+// to the render graph each frame.
+//   MSAA  multisampled colour and depth, resolved with a blit
+//   FXAA  one post-process pass over a single sampled target
+//   SMAA  1x: luma edge detection, blend weights from the length and end
+//         shape of each edge run, and neighbourhood blending
+// The scene target and the SMAA edges and weights are transient targets of
+// the graph. The passes are timed with timestamp queries read back a few
+// frames later, so the cost of a mode is its resolve time plus the
+// difference it makes to the scene passes.
+class AntiAliasing
+{
+public:
+    // Mode of the last passes added
+    AntiAliasingMode mode = AAOff;
+
+    // Statistics
+    float resolveMilliseconds = 0.0f;
+
+    // Constructor
+    AntiAliasing(const int width, const int height);
+
+    // Scene target of a mode, multisampling is limited to what the driver supports
+    TargetDesc sceneDesc(const AntiAliasingMode mode) const;
+
+    // Add the passes taking the scene, drawn to sceneDesc(mode), to the output
+    void addPasses(RenderGraph &graph, RenderTargetPool &pool, const AntiAliasingMode mode,
+                   const unsigned int scene, const unsigned int output);
+
+    // Name of a mode for printing
+    static const char *name(const AntiAliasingMode mode);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    int width, height;
+    int maxSamples;
+
+    // Programs
+    unsigned int fxaaShaderID;
+    unsigned int edgeShaderID;
+    unsigned int weightShaderID;
+    unsigned int blendShaderID;
+
+    unsigned int emptyVAO;
+
+    // Timestamps before and after the passes, in flight over several frames
+    static const unsigned int numQueries = 3;
+    unsigned int queries[numQueries][2];
+    unsigned int queryFrame = 0;
+
+    void beginTiming();
+    void endTiming();
+    void drawFullscreen(const unsigned int shaderID, const unsigned int texture, const unsigned int framebuffer);
+};
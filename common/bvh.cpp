@@ -0,0 +1,547 @@
+#include <cmath>
+#include <algorithm>
+
+#include <common/bvh.hpp>
+
+// Box helpers
+static AABB unionBox(const AABB &a, const AABB &b)
+{
+    AABB box;
+    box.min = glm::min(a.min, b.min);
+    box.max = glm::max(a.max, b.max);
+    return box;
+}
+
+static float area(const AABB &box)
+{
+    glm::vec3 d = box.max - box.min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static bool contains(const AABB &outer, const AABB &inner)
+{
+    return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::greaterThanEqual(outer.max, inner.max));
+}
+
+// Slab test, returns the entry distance or -1 if the ray misses
+static float rayBox(const glm::vec3 &origin, const glm::vec3 &inverseDirection, const float maxDistance, const AABB &box)
+{
+    glm::vec3 t1 = (box.min - origin) * inverseDirection;
+    glm::vec3 t2 = (box.max - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t1, t2);
+    glm::vec3 tFar = glm::max(t1, t2);
+    float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    return entry <= exit ? entry : -1.0f;
+}
+
+// Frustum classification: 0 outside, 1 intersecting, 2 inside
+static int classify(const Frustum &frustum, const AABB &box)
+{
+    glm::vec3 centre = 0.5f * (box.min + box.max);
+    glm::vec3 extent = 0.5f * (box.max - box.min);
+    int result = 2;
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4 &plane = frustum.planes[p];
+        float d = glm::dot(glm::vec3(plane), centre) + plane.w;
+        float r = glm::dot(glm::abs(glm::vec3(plane)), extent);
+        if (d + r < 0.0f)
+            return 0;
+        if (d - r < 0.0f)
+            result = 1;
+    }
+    return result;
+}
+
+BVH::~BVH()
+{
+    if (rebuilding)
+        pendingBuild.wait();
+}
+
+int BVH::allocateNode()
+{
+    if (!freeNodes.empty())
+    {
+        int node = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[node] = BVHNode();
+        return node;
+    }
+    nodes.push_back(BVHNode());
+    return static_cast<int>(nodes.size()) - 1;
+}
+
+void BVH::freeNode(const int node)
+{
+    nodes[node].proxy = -1;
+    nodes[node].left = nodes[node].right = -1;
+    freeNodes.push_back(node);
+}
+
+int BVH::insert(const AABB &box, const unsigned int userData)
+{
+    int proxy;
+    if (!freeProxies.empty())
+    {
+        proxy = freeProxies.back();
+        freeProxies.pop_back();
+    }
+    else
+    {
+        proxies.push_back(Proxy());
+        proxy = static_cast<int>(proxies.size()) - 1;
+    }
+
+    int leaf = allocateNode();
+    nodes[leaf].box.min = box.min - glm::vec3(margin);
+    nodes[leaf].box.max = box.max + glm::vec3(margin);
+    nodes[leaf].proxy = proxy;
+    proxies[proxy].box = box;
+    proxies[proxy].userData = userData;
+    proxies[proxy].node = leaf;
+    insertLeaf(leaf);
+
+    numProxies++;
+    rebuildInvalid = rebuilding;
+    return proxy;
+}
+
+void BVH::remove(const int proxy)
+{
+    int leaf = proxies[proxy].node;
+    removeLeaf(leaf);
+    freeNode(leaf);
+    proxies[proxy].node = -1;
+    freeProxies.push_back(proxy);
+
+    numProxies--;
+    rebuildInvalid = rebuilding;
+}
+
+bool BVH::update(const int proxy, const AABB &box)
+{
+    proxies[proxy].box = box;
+    int leaf = proxies[proxy].node;
+    if (contains(nodes[leaf].box, box))
+        return false;
+
+    // Grow the leaf and refit its ancestors in place
+    nodes[leaf].box.min = box.min - glm::vec3(margin);
+    nodes[leaf].box.max = box.max + glm::vec3(margin);
+    refit(nodes[leaf].parent);
+
+    if (rebuilding)
+        movedDuringRebuild.push_back(proxy);
+    return true;
+}
+
+void BVH::insertLeaf(const int leaf)
+{
+    if (root == -1)
+    {
+        root = leaf;
+        nodes[leaf].parent = -1;
+        return;
+    }
+
+    // Descend to the sibling with the lowest surface area cost
+    AABB leafBox = nodes[leaf].box;
+    int index = root;
+    while (nodes[index].left != -1)
+    {
+        int left = nodes[index].left;
+        int right = nodes[index].right;
+
+        float nodeArea = area(nodes[index].box);
+        float combinedArea = area(unionBox(nodes[index].box, leafBox));
+        float cost = 2.0f * combinedArea;
+        float inheritanceCost = 2.0f * (combinedArea - nodeArea);
+
+        float costLeft = area(unionBox(leafBox, nodes[left].box)) + inheritanceCost;
+        if (nodes[left].left != -1)
+            costLeft -= area(nodes[left].box);
+        float costRight = area(unionBox(leafBox, nodes[right].box)) + inheritanceCost;
+        if (nodes[right].left != -1)
+            costRight -= area(nodes[right].box);
+
+        if (cost < costLeft && cost < costRight)
+            break;
+        index = costLeft < costRight ? left : right;
+    }
+
+    // Create a new parent for the sibling and the leaf
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].box = unionBox(leafBox, nodes[sibling].box);
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    internalArea += area(nodes[newParent].box);
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent == -1)
+        root = newParent;
+    else if (nodes[oldParent].left == sibling)
+        nodes[oldParent].left = newParent;
+    else
+        nodes[oldParent].right = newParent;
+
+    refit(oldParent);
+}
+
+void BVH::removeLeaf(const int leaf)
+{
+    if (leaf == root)
+    {
+        root = -1;
+        return;
+    }
+
+    // Replace the parent with the leaf's sibling
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+    internalArea -= area(nodes[parent].box);
+
+    if (grandParent == -1)
+    {
+        root = sibling;
+        nodes[sibling].parent = -1;
+        freeNode(parent);
+        return;
+    }
+
+    if (nodes[grandParent].left == parent)
+        nodes[grandParent].left = sibling;
+    else
+        nodes[grandParent].right = sibling;
+    nodes[sibling].parent = grandParent;
+    freeNode(parent);
+    refit(grandParent);
+}
+
+void BVH::refit(int node)
+{
+    // Walk up to the root recomputing boxes, stopping once nothing changes
+    while (node != -1)
+    {
+        AABB box = unionBox(nodes[nodes[node].left].box, nodes[nodes[node].right].box);
+        if (box.min == nodes[node].box.min && box.max == nodes[node].box.max)
+            break;
+        internalArea += area(box) - area(nodes[node].box);
+        nodes[node].box = box;
+        node = nodes[node].parent;
+    }
+}
+
+float BVH::cost()
+{
+    return static_cast<float>(internalArea);
+}
+
+unsigned int BVH::size()
+{
+    return numProxies;
+}
+
+void BVH::maintain()
+{
+    if (rebuilding)
+    {
+        // Swap in the finished tree, then re-apply moves made while it was building
+        if (pendingBuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+
+        std::vector<BVHNode> newNodes = pendingBuild.get();
+        rebuilding = false;
+        if (!rebuildInvalid)
+        {
+            installTree(newNodes);
+            for (unsigned int i = 0; i < movedDuringRebuild.size(); i++)
+                update(movedDuringRebuild[i], proxies[movedDuringRebuild[i]].box);
+        }
+        movedDuringRebuild.clear();
+        rebuildInvalid = false;
+        return;
+    }
+
+    if (numProxies < 2 || cost() <= rebuildThreshold * builtCost)
+        return;
+
+    // Snapshot the leaves and build a new tree in the background
+    std::vector<std::pair<AABB, int> > leaves;
+    leaves.reserve(numProxies);
+    for (unsigned int i = 0; i < proxies.size(); i++)
+        if (proxies[i].node != -1)
+            leaves.push_back(std::make_pair(nodes[proxies[i].node].box, static_cast<int>(i)));
+
+    rebuilding = true;
+    rebuildInvalid = false;
+    pendingBuild = std::async(std::launch::async, &BVH::build, leaves);
+}
+
+void BVH::rebuild()
+{
+    if (rebuilding)
+    {
+        pendingBuild.wait();
+        pendingBuild.get();
+        rebuilding = false;
+        movedDuringRebuild.clear();
+    }
+
+    std::vector<std::pair<AABB, int> > leaves;
+    leaves.reserve(numProxies);
+    for (unsigned int i = 0; i < proxies.size(); i++)
+        if (proxies[i].node != -1)
+            leaves.push_back(std::make_pair(nodes[proxies[i].node].box, static_cast<int>(i)));
+
+    std::vector<BVHNode> newNodes = build(leaves);
+    installTree(newNodes);
+}
+
+void BVH::installTree(std::vector<BVHNode> &newNodes)
+{
+    nodes.swap(newNodes);
+    freeNodes.clear();
+    root = nodes.empty() ? -1 : 0;
+    for (unsigned int i = 0; i < nodes.size(); i++)
+        if (nodes[i].left == -1)
+            proxies[nodes[i].proxy].node = static_cast<int>(i);
+
+    // The built tree has no free nodes, so its internal area is a straight sum
+    internalArea = 0.0;
+    for (unsigned int i = 0; i < nodes.size(); i++)
+        if (nodes[i].left != -1)
+            internalArea += area(nodes[i].box);
+    builtCost = cost();
+}
+
+// Top-down binned SAH build over leaves [first, last)
+static int buildRecursive(std::vector<BVHNode> &nodes, std::vector<std::pair<AABB, int> > &leaves,
+                          const int first, const int last, const int parent)
+{
+    int index = static_cast<int>(nodes.size());
+    nodes.push_back(BVHNode());
+    nodes[index].parent = parent;
+
+    if (last - first == 1)
+    {
+        nodes[index].box = leaves[first].first;
+        nodes[index].proxy = leaves[first].second;
+        return index;
+    }
+
+    AABB box = leaves[first].first;
+    glm::vec3 centroidMin = 0.5f * (box.min + box.max);
+    glm::vec3 centroidMax = centroidMin;
+    for (int i = first + 1; i < last; i++)
+    {
+        box = unionBox(box, leaves[i].first);
+        glm::vec3 centroid = 0.5f * (leaves[i].first.min + leaves[i].first.max);
+        centroidMin = glm::min(centroidMin, centroid);
+        centroidMax = glm::max(centroidMax, centroid);
+    }
+    nodes[index].box = box;
+
+    // Split along the axis with the largest centroid spread
+    glm::vec3 spread = centroidMax - centroidMin;
+    int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+    int mid = (first + last) / 2;
+
+    if (spread[axis] > 0.0f)
+    {
+        // Bin the centroids and pick the split plane with the lowest surface area cost
+        const int numBins = 12;
+        AABB binBoxes[numBins];
+        int binCounts[numBins] = { 0 };
+        float binScale = numBins / spread[axis];
+        for (int i = first; i < last; i++)
+        {
+            float centroid = 0.5f * (leaves[i].first.min[axis] + leaves[i].first.max[axis]);
+            int bin = std::min(numBins - 1, static_cast<int>((centroid - centroidMin[axis]) * binScale));
+            binBoxes[bin] = binCounts[bin] == 0 ? leaves[i].first : unionBox(binBoxes[bin], leaves[i].first);
+            binCounts[bin]++;
+        }
+
+        // Sweep from the right to accumulate the right-hand areas, then from the left
+        float rightArea[numBins];
+        int rightCount[numBins];
+        AABB sweepBox;
+        int count = 0;
+        for (int b = numBins - 1; b > 0; b--)
+        {
+            if (binCounts[b] > 0)
+            {
+                sweepBox = count == 0 ? binBoxes[b] : unionBox(sweepBox, binBoxes[b]);
+                count += binCounts[b];
+            }
+            rightArea[b] = count > 0 ? area(sweepBox) : 0.0f;
+            rightCount[b] = count;
+        }
+
+        float bestCost = 1e30f;
+        int bestSplit = -1;
+        count = 0;
+        for (int split = 1; split < numBins; split++)
+        {
+            if (binCounts[split - 1] > 0)
+            {
+                sweepBox = count == 0 ? binBoxes[split - 1] : unionBox(sweepBox, binBoxes[split - 1]);
+                count += binCounts[split - 1];
+            }
+            if (count == 0 || rightCount[split] == 0)
+                continue;
+
+            float splitCost = count * area(sweepBox) + rightCount[split] * rightArea[split];
+            if (splitCost < bestCost)
+            {
+                bestCost = splitCost;
+                bestSplit = split;
+            }
+        }
+
+        if (bestSplit != -1)
+        {
+            float splitPosition = centroidMin[axis] + bestSplit / binScale;
+            auto middle = std::partition(leaves.begin() + first, leaves.begin() + last,
+                                         [axis, splitPosition](const std::pair<AABB, int> &leaf)
+                                         { return 0.5f * (leaf.first.min[axis] + leaf.first.max[axis]) < splitPosition; });
+            mid = static_cast<int>(middle - leaves.begin());
+        }
+    }
+
+    // Fall back to a median split if the bins could not separate the leaves
+    if (mid == first || mid == last)
+    {
+        mid = (first + last) / 2;
+        std::nth_element(leaves.begin() + first, leaves.begin() + mid, leaves.begin() + last,
+                         [axis](const std::pair<AABB, int> &a, const std::pair<AABB, int> &b)
+                         { return a.first.min[axis] + a.first.max[axis] < b.first.min[axis] + b.first.max[axis]; });
+    }
+
+    int left = buildRecursive(nodes, leaves, first, mid, index);
+    int right = buildRecursive(nodes, leaves, mid, last, index);
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+std::vector<BVHNode> BVH::build(std::vector<std::pair<AABB, int> > leaves)
+{
+    std::vector<BVHNode> newNodes;
+    if (leaves.empty())
+        return newNodes;
+
+    newNodes.reserve(2 * leaves.size());
+    buildRecursive(newNodes, leaves, 0, static_cast<int>(leaves.size()), -1);
+    return newNodes;
+}
+
+void BVH::queryFrustum(const Frustum &frustum, std::vector<unsigned int> &results)
+{
+    nodesVisited = 0;
+    if (root == -1)
+        return;
+
+    // Stack entries carry whether the node is already known to be fully inside
+    std::vector<std::pair<int, bool> > stack;
+    stack.reserve(64);
+    stack.push_back(std::make_pair(root, false));
+    while (!stack.empty())
+    {
+        int node = stack.back().first;
+        bool inside = stack.back().second;
+        stack.pop_back();
+        nodesVisited++;
+
+        if (!inside)
+        {
+            int result = classify(frustum, nodes[node].box);
+            if (result == 0)
+                continue;
+            inside = result == 2;
+        }
+
+        if (nodes[node].left == -1)
+        {
+            // Leaves are tested with their tight box
+            if (inside || classify(frustum, proxies[nodes[node].proxy].box) != 0)
+                results.push_back(proxies[nodes[node].proxy].userData);
+            continue;
+        }
+        stack.push_back(std::make_pair(nodes[node].left, inside));
+        stack.push_back(std::make_pair(nodes[node].right, inside));
+    }
+}
+
+void BVH::queryRay(const glm::vec3 &origin, const glm::vec3 &direction, const float maxDistance,
+                   std::vector<unsigned int> &results)
+{
+    nodesVisited = 0;
+    if (root == -1)
+        return;
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+    std::vector<int> stack(1, root);
+    while (!stack.empty())
+    {
+        int node = stack.back();
+        stack.pop_back();
+        nodesVisited++;
+
+        if (rayBox(origin, inverseDirection, maxDistance, nodes[node].box) < 0.0f)
+            continue;
+
+        if (nodes[node].left == -1)
+        {
+            if (rayBox(origin, inverseDirection, maxDistance, proxies[nodes[node].proxy].box) >= 0.0f)
+                results.push_back(proxies[nodes[node].proxy].userData);
+            continue;
+        }
+        stack.push_back(nodes[node].left);
+        stack.push_back(nodes[node].right);
+    }
+}
+
+int BVH::raycast(const glm::vec3 &origin, const glm::vec3 &direction, const float maxDistance,
+                 float &hitDistance)
+{
+    nodesVisited = 0;
+    int hit = -1;
+    hitDistance = maxDistance;
+    if (root == -1)
+        return hit;
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+    std::vector<int> stack(1, root);
+    while (!stack.empty())
+    {
+        int node = stack.back();
+        stack.pop_back();
+        nodesVisited++;
+
+        // Skip nodes further away than the nearest hit so far
+        if (rayBox(origin, inverseDirection, hitDistance, nodes[node].box) < 0.0f)
+            continue;
+
+        if (nodes[node].left == -1)
+        {
+            float distance = rayBox(origin, inverseDirection, hitDistance, proxies[nodes[node].proxy].box);
+            if (distance >= 0.0f && distance < hitDistance)
+            {
+                hitDistance = distance;
+                hit = static_cast<int>(proxies[nodes[node].proxy].userData);
+            }
+            continue;
+        }
+        stack.push_back(nodes[node].left);
+        stack.push_back(nodes[node].right);
+    }
+
+    return hit;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <future>
+
+#include <glm/glm.hpp>
+
+#include <common/maths.hpp>
+#include <common/culling.hpp>
+
+// Node of the bounding volume hierarchy, leaves have left == -1
+struct BVHNode
+{
+    AABB box;
+    int parent = -1;
+    int left = -1;
+    int right = -1;
+    int proxy = -1;
+};
+
+// Dynamic bounding volume hierarchy over scene objects. Leaves store a fat
+// box so small movements need no update, larger ones refit the ancestors in
+// place. When refitting has degraded the tree too far a binned SAH rebuild
+// runs on a background thread and is swapped in by maintain().
+class BVH
+{
+public:
+    // Fat box margin added around each leaf
+    float margin = 0.1f;
+
+    // Rebuild once the tree's surface area cost has grown by this factor
+    float rebuildThreshold = 1.5f;
+
+    // Nodes visited by the last query
+    unsigned int nodesVisited = 0;
+
+    // Add an object and return its proxy ID
+    int insert(const AABB &box, const unsigned int userData);
+
+    // Remove an object
+    void remove(const int proxy);
+
+    // Update the box of a moved object, returns true if the tree changed
+    bool update(const int proxy, const AABB &box);
+
+    // Call once a frame to start or finish background rebuilds
+    void maintain();
+
+    // Append the user data of objects whose boxes intersect the frustum
+    void queryFrustum(const Frustum &frustum, std::vector<unsigned int> &results);
+
+    // Append the user data of objects whose boxes the ray passes through
+    void queryRay(const glm::vec3 &origin, const glm::vec3 &direction, const float maxDistance,
+                  std::vector<unsigned int> &results);
+
+    // User data of the nearest box hit by the ray or -1, with its distance
+    int raycast(const glm::vec3 &origin, const glm::vec3 &direction, const float maxDistance,
+                float &hitDistance);
+
+    // Surface area cost of the tree, the sum of the internal node areas, kept up to
+    // date by insert, remove and refit so checking it each frame costs nothing
+    float cost();
+
+    // Rebuild the whole tree immediately
+    void rebuild();
+
+    // Number of objects in the tree
+    unsigned int size();
+
+    // Destructor waits for any background rebuild
+    ~BVH();
+
+private:
+    struct Proxy
+    {
+        AABB box;
+        unsigned int userData;
+        int node;
+    };
+
+    std::vector<BVHNode> nodes;
+    std::vector<int> freeNodes;
+    std::vector<Proxy> proxies;
+    std::vector<int> freeProxies;
+    int root = -1;
+    unsigned int numProxies = 0;
+    float builtCost = 0.0f;
+    double internalArea = 0.0;
+
+    // Background rebuild state
+    std::future<std::vector<BVHNode> > pendingBuild;
+    bool rebuilding = false;
+    bool rebuildInvalid = false;
+    std::vector<int> movedDuringRebuild;
+
+    int allocateNode();
+    void freeNode(const int node);
+    void insertLeaf(const int leaf);
+    void removeLeaf(const int leaf);
+    void refit(int node);
+    void installTree(std::vector<BVHNode> &newNodes);
+
+    // Build a tree over the given proxies with a binned SAH, leaves store the proxy index
+    static std::vector<BVHNode> build(std::vector<std::pair<AABB, int> > leaves);
+};
@@ -34,15 +34,27 @@ void Camera::quaternionCamera()
     // Calculate camera orientation quaternion from the Euler angles
     Quaternion newOrientation(-pitch, yaw);
 
-    // Apply SLERP
+    // Apply SLERP, this returns newOrientation exactly once it is close enough
     orientation = Maths::SLERP(orientation, newOrientation, 0.2f);
 
-
-    // Calculate the view matrix
-    view = orientation.matrix() * Maths::translate(-eye);
-
-    // Calculate the projection matrix
-    projection = glm::perspective(fov, aspect, near, far);
+    // Calculate the view matrix only when the camera has moved or turned
+    viewChanged = eye != viewEye || orientation.w != viewOrientation.w || orientation.x != viewOrientation.x ||
+                  orientation.y != viewOrientation.y || orientation.z != viewOrientation.z;
+    if (viewChanged)
+    {
+        view = orientation.matrix() * Maths::translate(-eye);
+        viewEye = eye;
+        viewOrientation = orientation;
+    }
+
+    // Calculate the projection matrix only when its parameters change
+    glm::vec4 parameters(fov, aspect, near, far);
+    projectionChanged = parameters != projectionParameters;
+    if (projectionChanged)
+    {
+        projection = glm::perspective(fov, aspect, near, far);
+        projectionParameters = parameters;
+    }
 
     // Calculate camera vectors from view matrix
     right = glm::vec3(view[0][0], view[1][0], view[2][0]);
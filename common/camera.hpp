@@ -31,6 +31,10 @@ public:
     glm::mat4 view;
     glm::mat4 projection;
 
+    // Set by quaternionCamera when the matrices were recalculated this frame
+    bool viewChanged = true;
+    bool projectionChanged = true;
+
     // Constructor
     Camera(const glm::vec3 eye, const glm::vec3 target);
 
@@ -42,4 +46,10 @@ public:
 
     // Quaternion camera
     Quaternion orientation = Quaternion(pitch, yaw);
+
+private:
+    // Parameters the cached matrices were calculated from
+    glm::vec3 viewEye;
+    Quaternion viewOrientation = Quaternion(0.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec4 projectionParameters = glm::vec4(0.0f);
 };
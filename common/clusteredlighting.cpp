@@ -0,0 +1,74 @@
+#include <cmath>
+#include <algorithm>
+
+#include <common/clusteredlighting.hpp>
+#include <common/streambuffer.hpp>
+#include <common/shader.hpp>
+
+ClusteredLighting::ClusteredLighting(const int width, const int height)
+{
+    this->width = width;
+    this->height = height;
+
+    // Reuses the G-buffer vertex shader, the view position comes from the fragment's depth
+    shaderID = LoadShaders("gBufferVertexShader.glsl", "clusteredFragmentShader.glsl");
+    glUniformBlockBinding(shaderID, glGetUniformBlockIndex(shaderID, "ObjectBlock"), objectBlockBinding);
+
+    GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+    glGenBuffers(3, buffers);
+    glGenTextures(3, textures);
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLighting::upload(const LightClusters &clusters, const glm::mat4 &projection, const float near, const float far)
+{
+    // Orphan and refill each buffer
+    const void *data[3] = { clusters.lightData.data(), clusters.clusterRanges.data(), clusters.lightIndices.data() };
+    size_t sizes[3] = { clusters.lightData.size() * sizeof(glm::vec4),
+                        clusters.clusterRanges.size() * sizeof(unsigned int),
+                        clusters.lightIndices.size() * sizeof(unsigned int) };
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, std::max(sizes[i], size_t(16)), NULL, GL_STREAM_DRAW);
+        if (sizes[i] > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glUseProgram(shaderID);
+    const char *names[3] = { "lightData", "clusterRanges", "lightIndices" };
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glUniform1i(glGetUniformLocation(shaderID, names[i]), firstUnit + i);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    // Grid uniforms, the slice of a view depth d is log(d / near) * sliceScale
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    glUniformMatrix4fv(glGetUniformLocation(shaderID, "inverseP"), 1, GL_FALSE, &inverseProjection[0][0]);
+    glUniform2f(glGetUniformLocation(shaderID, "tileSize"), static_cast<float>(width) / clusters.tilesX,
+                static_cast<float>(height) / clusters.tilesY);
+    glUniform3i(glGetUniformLocation(shaderID, "gridSize"), clusters.tilesX, clusters.tilesY, clusters.slices);
+    glUniform1f(glGetUniformLocation(shaderID, "near"), near);
+    glUniform1f(glGetUniformLocation(shaderID, "sliceScale"), clusters.slices / logf(far / near));
+    glUniform2f(glGetUniformLocation(shaderID, "screenSize"), static_cast<float>(width), static_cast<float>(height));
+    glUniform1i(glGetUniformLocation(shaderID, "numGlobalLights"), clusters.numGlobalLights);
+}
+
+void ClusteredLighting::deleteBuffers()
+{
+    glDeleteTextures(3, textures);
+    glDeleteBuffers(3, buffers);
+    glDeleteProgram(shaderID);
+}
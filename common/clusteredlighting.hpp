@@ -0,0 +1,35 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/lightclusters.hpp>
+
+// Clustered forward shading. The light clusters are uploaded each frame
+// into texture buffers, so the number of lights is only limited by memory,
+// and the forward program loops over the lights of each fragment's cluster.
+class ClusteredLighting
+{
+public:
+    // Forward program reading the clusters
+    unsigned int shaderID;
+
+    // Constructor
+    ClusteredLighting(const int width, const int height);
+
+    // Upload the clusters and bind them and the grid uniforms to the program
+    void upload(const LightClusters &clusters, const glm::mat4 &projection, const float near, const float far);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    // Texture units above the material textures
+    static const unsigned int firstUnit = 8;
+
+    int width, height;
+
+    // Light data, cluster ranges and light indices
+    unsigned int buffers[3];
+    unsigned int textures[3];
+};
@@ -0,0 +1,261 @@
+#include <cmath>
+
+#include <common/culling.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define CULLING_AVX
+#include <immintrin.h>
+#endif
+
+// Frustum
+Frustum::Frustum() {}
+
+Frustum::Frustum(const glm::mat4 &viewProjection)
+{
+    // Gribb-Hartmann extraction from the rows of the matrix
+    glm::vec4 row0 = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    glm::vec4 row1 = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    glm::vec4 row2 = glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    glm::vec4 row3 = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row3 + row2;
+    planes[5] = row3 - row2;
+
+    for (int i = 0; i < 6; i++)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+// Bounds array
+unsigned int BoundsArray::size()
+{
+    return static_cast<unsigned int>(centreX.size());
+}
+
+void BoundsArray::add(const AABB &box)
+{
+    centreX.push_back(0.0f); centreY.push_back(0.0f); centreZ.push_back(0.0f);
+    extentX.push_back(0.0f); extentY.push_back(0.0f); extentZ.push_back(0.0f);
+    radius.push_back(0.0f);
+    set(size() - 1, box);
+}
+
+void BoundsArray::set(const unsigned int index, const AABB &box)
+{
+    glm::vec3 centre = 0.5f * (box.min + box.max);
+    glm::vec3 extent = 0.5f * (box.max - box.min);
+    centreX[index] = centre.x; centreY[index] = centre.y; centreZ[index] = centre.z;
+    extentX[index] = extent.x; extentY[index] = extent.y; extentZ[index] = extent.z;
+    radius[index] = glm::length(extent);
+}
+
+void BoundsArray::removeLast()
+{
+    centreX.pop_back(); centreY.pop_back(); centreZ.pop_back();
+    extentX.pop_back(); extentY.pop_back(); extentZ.pop_back();
+    radius.pop_back();
+}
+
+void BoundsArray::clear()
+{
+    centreX.clear(); centreY.clear(); centreZ.clear();
+    extentX.clear(); extentY.clear(); extentZ.clear();
+    radius.clear();
+}
+
+AABB BoundsArray::box(const unsigned int index)
+{
+    glm::vec3 centre(centreX[index], centreY[index], centreZ[index]);
+    glm::vec3 extent(extentX[index], extentY[index], extentZ[index]);
+    AABB result;
+    result.min = centre - extent;
+    result.max = centre + extent;
+    return result;
+}
+
+// Test a single box
+static inline bool testBox(const Frustum &frustum, BoundsArray &bounds,
+                           const float projectionScale, const float minSize, const unsigned int i)
+{
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4 &plane = frustum.planes[p];
+        float d = plane.x * bounds.centreX[i] + plane.y * bounds.centreY[i] + plane.z * bounds.centreZ[i] + plane.w;
+        float r = fabs(plane.x) * bounds.extentX[i] + fabs(plane.y) * bounds.extentY[i] + fabs(plane.z) * bounds.extentZ[i];
+        if (d + r < 0.0f)
+            return false;
+    }
+
+    // Projected size, the distance to the near plane approximates the view depth
+    const glm::vec4 &near = frustum.planes[4];
+    float depth = near.x * bounds.centreX[i] + near.y * bounds.centreY[i] + near.z * bounds.centreZ[i] + near.w;
+    return !(depth > bounds.radius[i] && bounds.radius[i] * projectionScale < minSize * depth);
+}
+
+// Test boxes [first, last) one at a time
+static unsigned int cullRangeScalar(const Frustum &frustum, BoundsArray &bounds,
+                              const float projectionScale, const float minSize,
+                              const unsigned int first, const unsigned int last,
+                              std::vector<unsigned int> &visible)
+{
+    unsigned int count = 0;
+    for (unsigned int i = first; i < last; i++)
+    {
+        if (!testBox(frustum, bounds, projectionScale, minSize, i))
+            continue;
+
+        visible.push_back(i);
+        count++;
+    }
+
+    return count;
+}
+
+unsigned int Culling::cullBoxesScalar(const Frustum &frustum, BoundsArray &bounds,
+                                      const float projectionScale, const float minSize,
+                                      std::vector<unsigned int> &visible)
+{
+    return cullRangeScalar(frustum, bounds, projectionScale, minSize, 0, bounds.size(), visible);
+}
+
+unsigned int Culling::cullBoxes(const Frustum &frustum, BoundsArray &bounds,
+                                const float projectionScale, const float minSize,
+                                std::vector<unsigned int> &visible)
+{
+    return cullRange(frustum, bounds, projectionScale, minSize, 0, bounds.size(), visible);
+}
+
+unsigned int Culling::cullRange(const Frustum &frustum, BoundsArray &bounds,
+                                const float projectionScale, const float minSize,
+                                const unsigned int first, const unsigned int last,
+                                std::vector<unsigned int> &visible)
+{
+    unsigned int n = last;
+    unsigned int i = first;
+    unsigned int count = 0;
+
+#if defined(CULLING_AVX)
+    // Eight boxes at a time
+    __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 scale = _mm256_set1_ps(projectionScale);
+    __m256 size = _mm256_set1_ps(minSize);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(&bounds.centreX[i]);
+        __m256 cy = _mm256_loadu_ps(&bounds.centreY[i]);
+        __m256 cz = _mm256_loadu_ps(&bounds.centreZ[i]);
+        __m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+        __m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+        __m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+        __m256 r = _mm256_loadu_ps(&bounds.radius[i]);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        __m256 nearDistance = zero;
+        for (int p = 0; p < 6; p++)
+        {
+            const glm::vec4 &plane = frustum.planes[p];
+            __m256 nx = _mm256_set1_ps(plane.x), ny = _mm256_set1_ps(plane.y), nz = _mm256_set1_ps(plane.z);
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)),
+                                     _mm256_add_ps(_mm256_mul_ps(nz, cz), _mm256_set1_ps(plane.w)));
+            __m256 e = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask, nx), ex),
+                                                   _mm256_mul_ps(_mm256_andnot_ps(signMask, ny), ey)),
+                                     _mm256_mul_ps(_mm256_andnot_ps(signMask, nz), ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, e), zero, _CMP_GE_OQ));
+            if (p == 4)
+                nearDistance = d;
+        }
+
+        // Keep boxes that straddle the near plane or project to at least minSize
+        __m256 large = _mm256_or_ps(_mm256_cmp_ps(nearDistance, r, _CMP_LE_OQ),
+                                    _mm256_cmp_ps(_mm256_mul_ps(r, scale), _mm256_mul_ps(size, nearDistance), _CMP_GE_OQ));
+        int mask = _mm256_movemask_ps(_mm256_and_ps(inside, large));
+        while (mask)
+        {
+            int lane = 0;
+            while (!(mask & (1 << lane)))
+                lane++;
+            visible.push_back(i + lane);
+            mask &= mask - 1;
+            count++;
+        }
+    }
+#endif
+
+#if defined(CULLING_SSE)
+    // Four boxes at a time
+    __m128 signMask4 = _mm_set1_ps(-0.0f);
+    __m128 zero4 = _mm_setzero_ps();
+    __m128 scale4 = _mm_set1_ps(projectionScale);
+    __m128 size4 = _mm_set1_ps(minSize);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&bounds.centreX[i]);
+        __m128 cy = _mm_loadu_ps(&bounds.centreY[i]);
+        __m128 cz = _mm_loadu_ps(&bounds.centreZ[i]);
+        __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+        __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+        __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+        __m128 r = _mm_loadu_ps(&bounds.radius[i]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128 nearDistance = zero4;
+        for (int p = 0; p < 6; p++)
+        {
+            const glm::vec4 &plane = frustum.planes[p];
+            __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                                  _mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(plane.w)));
+            __m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask4, nx), ex),
+                                             _mm_mul_ps(_mm_andnot_ps(signMask4, ny), ey)),
+                                  _mm_mul_ps(_mm_andnot_ps(signMask4, nz), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, e), zero4));
+            if (p == 4)
+                nearDistance = d;
+        }
+
+        __m128 large = _mm_or_ps(_mm_cmple_ps(nearDistance, r),
+                                 _mm_cmpge_ps(_mm_mul_ps(r, scale4), _mm_mul_ps(size4, nearDistance)));
+        int mask = _mm_movemask_ps(_mm_and_ps(inside, large));
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (mask & (1 << lane))
+            {
+                visible.push_back(i + lane);
+                count++;
+            }
+        }
+    }
+#endif
+
+    // Remaining boxes
+    count += cullRangeScalar(frustum, bounds, projectionScale, minSize, i, n, visible);
+
+    return count;
+}
+
+unsigned int Culling::cullCandidates(const Frustum &frustum, BoundsArray &bounds,
+                                     const float projectionScale, const float minSize,
+                                     const std::vector<unsigned int> &candidates,
+                                     std::vector<unsigned int> &visible)
+{
+    unsigned int count = 0;
+    for (unsigned int c = 0; c < candidates.size(); c++)
+    {
+        if (!testBox(frustum, bounds, projectionScale, minSize, candidates[c]))
+            continue;
+
+        visible.push_back(candidates[c]);
+        count++;
+    }
+
+    return count;
+}
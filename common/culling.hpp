@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <common/maths.hpp>
+
+// Frustum planes (left, right, bottom, top, near, far) extracted from a
+// view-projection matrix. Planes are normalised with normals pointing inwards.
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    // Constructors
+    Frustum();
+    Frustum(const glm::mat4 &viewProjection);
+};
+
+// World space bounding volumes in structure-of-arrays layout so that they
+// can be tested four or eight at a time
+class BoundsArray
+{
+public:
+    std::vector<float> centreX, centreY, centreZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+
+    // Number of bounding volumes
+    unsigned int size();
+
+    // Add or replace the bounding volumes of an object
+    void add(const AABB &box);
+    void set(const unsigned int index, const AABB &box);
+    void removeLast();
+    void clear();
+
+    // Box of an object
+    AABB box(const unsigned int index);
+};
+
+// Culling namespace
+namespace Culling
+{
+    // Append the indices of the boxes that intersect the frustum to visible.
+    // Boxes whose bounding sphere projects to less than minSize (a fraction of
+    // the viewport height) are rejected too. projectionScale is projection[1][1].
+    // Returns the number of visible boxes.
+    unsigned int cullBoxes(const Frustum &frustum, BoundsArray &bounds,
+                           const float projectionScale, const float minSize,
+                           std::vector<unsigned int> &visible);
+
+    // cullBoxes over the boxes [first, last), for splitting the work across threads
+    unsigned int cullRange(const Frustum &frustum, BoundsArray &bounds,
+                           const float projectionScale, const float minSize,
+                           const unsigned int first, const unsigned int last,
+                           std::vector<unsigned int> &visible);
+
+    // Scalar reference version of cullBoxes
+    unsigned int cullBoxesScalar(const Frustum &frustum, BoundsArray &bounds,
+                                 const float projectionScale, const float minSize,
+                                 std::vector<unsigned int> &visible);
+
+    // cullBoxes over a pre-filtered subset of the boxes, such as a PVS cell
+    unsigned int cullCandidates(const Frustum &frustum, BoundsArray &bounds,
+                                const float projectionScale, const float minSize,
+                                const std::vector<unsigned int> &candidates,
+                                std::vector<unsigned int> &visible);
+}
@@ -0,0 +1,208 @@
+#include <cmath>
+#include <stdio.h>
+#include <algorithm>
+
+#include <common/deferred.hpp>
+#include <common/culling.hpp>
+#include <common/shader.hpp>
+
+DeferredRenderer::DeferredRenderer(const int width, const int height, const char *spherePath) : sphere(spherePath)
+{
+    this->width = width;
+    this->height = height;
+
+    // A tessellated sphere lies inside the true sphere, scale it by its smallest face distance
+    float inradius = 1.0f;
+    for (unsigned int i = 0; i + 2 < sphere.vertices.size(); i += 3)
+    {
+        glm::vec3 normal = glm::cross(sphere.vertices[i + 1] - sphere.vertices[i], sphere.vertices[i + 2] - sphere.vertices[i]);
+        if (glm::dot(normal, normal) > 0.0f)
+            inradius = std::min(inradius, fabsf(glm::dot(glm::normalize(normal), sphere.vertices[i])));
+    }
+    sphereScale = 1.0f / std::max(inradius, 0.1f);
+
+    // Programs
+    geometryShaderID = LoadShaders("gBufferVertexShader.glsl", "gBufferFragmentShader.glsl");
+    glUniformBlockBinding(geometryShaderID, glGetUniformBlockIndex(geometryShaderID, "ObjectBlock"), objectBlockBinding);
+    stencilShaderID = LoadShaders("lightVolumeVertexShader.glsl", "depthFragmentShader.glsl");
+    volumeShaderID = LoadShaders("lightVolumeVertexShader.glsl", "deferredLightFragmentShader.glsl");
+    fullscreenShaderID = LoadShaders("fullscreenVertexShader.glsl", "deferredLightFragmentShader.glsl");
+    compositeShaderID = LoadShaders("fullscreenVertexShader.glsl", "compositeFragmentShader.glsl");
+
+    glGenVertexArrays(1, &emptyVAO);
+
+    printf("Deferred: %dx%d G-buffer, %d bytes per pixel\n", width, height, 4 + 4 + 4 + 4);
+}
+
+void DeferredRenderer::beginGeometry(const DeferredTargets &targets)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, targets.gBufferFBO);
+    glViewport(0, 0, width, height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    glDisable(GL_BLEND);
+    glUseProgram(geometryShaderID);
+}
+
+void DeferredRenderer::bindGBuffer(const unsigned int shaderID, const DeferredTargets &targets, const glm::mat4 &projection)
+{
+    glUseProgram(shaderID);
+    unsigned int textures[] = { targets.albedoTexture, targets.normalTexture, targets.materialTexture, targets.depthTexture };
+    const char *names[] = { "albedoMap", "normalMap", "materialMap", "depthMap" };
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glUniform1i(glGetUniformLocation(shaderID, names[i]), i);
+    }
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    glUniformMatrix4fv(glGetUniformLocation(shaderID, "inverseP"), 1, GL_FALSE, &inverseProjection[0][0]);
+    glUniform2f(glGetUniformLocation(shaderID, "screenSize"), static_cast<float>(width), static_cast<float>(height));
+}
+
+void DeferredRenderer::setLight(const unsigned int shaderID, const LightSource &light, const glm::mat4 &view)
+{
+    glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+    glm::vec3 direction = glm::vec3(view * glm::vec4(light.direction, 0.0f));
+    glUniform3fv(glGetUniformLocation(shaderID, "lightPosition"), 1, &position[0]);
+    glUniform3fv(glGetUniformLocation(shaderID, "lightDirection"), 1, &direction[0]);
+    glUniform3fv(glGetUniformLocation(shaderID, "lightColour"), 1, &light.colour[0]);
+    glUniform1f(glGetUniformLocation(shaderID, "constant"), light.constant);
+    glUniform1f(glGetUniformLocation(shaderID, "linear"), light.linear);
+    glUniform1f(glGetUniformLocation(shaderID, "quadratic"), light.quadratic);
+    glUniform1f(glGetUniformLocation(shaderID, "cosPhi"), light.cosPhi);
+    glUniform1i(glGetUniformLocation(shaderID, "type"), light.type);
+}
+
+void DeferredRenderer::drawLights(const DeferredTargets &targets, const std::vector<LightSource> &lights, const glm::mat4 &view,
+                                  const glm::mat4 &projection)
+{
+    numLightVolumes = 0;
+    numFullscreenLights = 0;
+    numCulledLights = 0;
+
+    // The light buffer gets the scene depth for the stencil pass
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, targets.gBufferFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targets.lightFBO);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, targets.lightFBO);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glDepthMask(GL_FALSE);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glm::mat4 viewProjection = projection * view;
+    Frustum frustum(viewProjection);
+
+    // Point and spot lights, each a stencil pass then a lighting pass over its volume. The
+    // stencil is cleared once here, each lighting pass zeroes the pixels it marked again.
+    // Depth clamping keeps volumes crossing the far plane from losing their back faces.
+    glEnable(GL_STENCIL_TEST);
+    glEnable(GL_DEPTH_CLAMP);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    glUseProgram(volumeShaderID);
+    bindGBuffer(volumeShaderID, targets, projection);
+    for (unsigned int i = 0; i < lights.size(); i++)
+    {
+        const LightSource &light = lights[i];
+        if (light.type != 1 && light.type != 2)
+            continue;
+
+        // Lights without a finite range are drawn full screen
+        float radius = Light::influenceRadius(light);
+        if (!std::isfinite(radius))
+            continue;
+        bool outside = radius <= 0.0f;
+        for (unsigned int p = 0; p < 6 && !outside; p++)
+            outside = glm::dot(glm::vec3(frustum.planes[p]), light.position) + frustum.planes[p].w < -radius;
+        if (outside)
+        {
+            numCulledLights++;
+            continue;
+        }
+        glm::mat4 MVP = viewProjection * Maths::translate(light.position) * Maths::scale(glm::vec3(radius * sphereScale));
+
+        // Count back faces behind the surface up and front faces behind it down, so pixels
+        // whose surface is inside the volume are left non-zero
+        glUseProgram(stencilShaderID);
+        glUniformMatrix4fv(glGetUniformLocation(stencilShaderID, "MVP"), 1, GL_FALSE, &MVP[0][0]);
+        glDrawBuffer(GL_NONE);
+        glEnable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glStencilFunc(GL_ALWAYS, 0, 0);
+        glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+        glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+        sphere.drawMesh();
+
+        // Shade the marked pixels and reset their stencil for the next light, drawing back
+        // faces so the camera may be inside the volume. With depth clamping no back face is
+        // clipped, so they cover every pixel the stencil pass marked.
+        glUseProgram(volumeShaderID);
+        glUniformMatrix4fv(glGetUniformLocation(volumeShaderID, "MVP"), 1, GL_FALSE, &MVP[0][0]);
+        setLight(volumeShaderID, light, view);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        glStencilFunc(GL_NOTEQUAL, 0, 0xff);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+        sphere.drawMesh();
+        glCullFace(GL_BACK);
+        glDisable(GL_BLEND);
+        numLightVolumes++;
+    }
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    glDisable(GL_DEPTH_CLAMP);
+    glDisable(GL_STENCIL_TEST);
+
+    // Directional and unbounded lights cover the whole screen
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    bindGBuffer(fullscreenShaderID, targets, projection);
+    glBindVertexArray(emptyVAO);
+    for (unsigned int i = 0; i < lights.size(); i++)
+    {
+        if (lights[i].type != 3 && std::isfinite(Light::influenceRadius(lights[i])))
+            continue;
+
+        setLight(fullscreenShaderID, lights[i], view);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        numFullscreenLights++;
+    }
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+}
+
+void DeferredRenderer::composite(const DeferredTargets &targets, const unsigned int framebuffer)
+{
+    // Background pixels are discarded so the framebuffer keeps its clear colour,
+    // the depth is written so forward passes can follow
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glDepthFunc(GL_ALWAYS);
+    glUseProgram(compositeShaderID);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, targets.lightTexture);
+    glUniform1i(glGetUniformLocation(compositeShaderID, "lightMap"), 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, targets.depthTexture);
+    glUniform1i(glGetUniformLocation(compositeShaderID, "depthMap"), 1);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+    glDepthFunc(GL_LESS);
+}
+
+void DeferredRenderer::deleteBuffers()
+{
+    sphere.deleteBuffers();
+    glDeleteVertexArrays(1, &emptyVAO);
+    glDeleteProgram(geometryShaderID);
+    glDeleteProgram(stencilShaderID);
+    glDeleteProgram(volumeShaderID);
+    glDeleteProgram(fullscreenShaderID);
+    glDeleteProgram(compositeShaderID);
+}
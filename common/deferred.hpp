@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/model.hpp>
+#include <common/light.hpp>
+
+// G-buffer and light accumulation targets of a frame, transient targets of the
+// render graph. The light buffer has its own depth and stencil.
+struct DeferredTargets
+{
+    unsigned int gBufferFBO;
+    unsigned int albedoTexture, normalTexture, materialTexture, depthTexture;
+    unsigned int lightFBO;
+    unsigned int lightTexture;
+};
+
+// Deferred shading. Opaque geometry is drawn once into a compact G-buffer:
+//   albedo   RGBA8  albedo (rgb), ka (a)
+//   normal   RG16F  octahedral view space normal
+//   material RGBA8  kd, ks, specular map, Ns / 255
+//   depth    DEPTH24_STENCIL8
+// Point and spot lights are then accumulated by rasterising a sphere around
+// each light's influence radius, with a stencil pass marking the pixels whose
+// surface lies inside the volume so that only those are shaded. Directional
+// lights are full screen passes. The cost is per lit pixel rather than per
+// fragment times lights, so hundreds of lights are practical.
+class DeferredRenderer
+{
+public:
+    // Program for the geometry pass, it takes the same inputs as the forward shader
+    unsigned int geometryShaderID;
+
+    // Statistics for the last frame
+    unsigned int numLightVolumes = 0;
+    unsigned int numFullscreenLights = 0;
+    unsigned int numCulledLights = 0;
+
+    // Constructor, the light volumes are instances of the given sphere mesh
+    DeferredRenderer(const int width, const int height, const char *spherePath);
+
+    // Bind and clear the G-buffer, the caller then draws the opaque geometry with geometryShaderID
+    void beginGeometry(const DeferredTargets &targets);
+
+    // Accumulate the world space lights into the light buffer
+    void drawLights(const DeferredTargets &targets, const std::vector<LightSource> &lights, const glm::mat4 &view,
+                    const glm::mat4 &projection);
+
+    // Copy the lit image and the G-buffer depth to the scene framebuffer
+    void composite(const DeferredTargets &targets, const unsigned int framebuffer);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    int width, height;
+
+    // Light volume mesh, scaled so its faces enclose the unit sphere
+    Model sphere;
+    float sphereScale;
+
+    // Programs
+    unsigned int stencilShaderID;
+    unsigned int volumeShaderID;
+    unsigned int fullscreenShaderID;
+    unsigned int compositeShaderID;
+
+    unsigned int emptyVAO;
+
+    // Bind the G-buffer textures and per-light uniforms of a lighting program
+    void bindGBuffer(const unsigned int shaderID, const DeferredTargets &targets, const glm::mat4 &projection);
+    void setLight(const unsigned int shaderID, const LightSource &light, const glm::mat4 &view);
+};
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <algorithm>
+
+#include <common/drawlist.hpp>
+#include <common/jobsystem.hpp>
+
+// Chunks per thread, several so that uneven chunks balance out
+static const unsigned int chunksPerThread = 4;
+
+static float millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void DrawList::build(EntityStore &entities, const std::vector<unsigned int> *visible,
+                     const glm::mat4 &view, const glm::mat4 &projection, const float near, const float far,
+                     const float minSize, const unsigned char skipFlags)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    unsigned int n = visible ? static_cast<unsigned int>(visible->size()) : entities.size();
+    unsigned int numChunks = jobs ? chunksPerThread * jobs->size() : 1;
+    unsigned int chunkSize = std::max(1u, (n + numChunks - 1) / numChunks);
+    numChunks = std::max(1u, (n + chunkSize - 1) / chunkSize);
+    if (lists.size() < numChunks)
+        lists.resize(numChunks);
+
+    // Cull, transform and key each chunk into its own list
+    Frustum frustum(projection * view);
+    auto buildChunk = [&](const unsigned int c)
+    {
+        CommandList &list = lists[c];
+        list.items.clear();
+        list.draws.clear();
+        list.entities.clear();
+        unsigned int first = c * chunkSize;
+        unsigned int last = std::min(n, first + chunkSize);
+        const unsigned int *indices;
+        unsigned int count;
+        if (visible)
+        {
+            indices = visible->data() + first;
+            count = last - first;
+        }
+        else
+        {
+            list.visible.clear();
+            Culling::cullRange(frustum, entities.bounds, projection[1][1], minSize, first, last, list.visible);
+            indices = list.visible.data();
+            count = static_cast<unsigned int>(list.visible.size());
+        }
+
+        for (unsigned int v = 0; v < count; v++)
+        {
+            unsigned int i = indices[v];
+            if (entities.flags[i] & skipFlags)
+                continue;
+
+            DrawData draw;
+            draw.MV = view * entities.worlds[i];
+            draw.MVP = projection * draw.MV;
+            float depth = (-draw.MV[3].z - near) / (far - near);
+            RenderPass pass = (entities.flags[i] & EntityTransparent) ? PassTransparent : PassOpaque;
+
+            RenderItem item;
+            item.key = RenderQueue::makeKey(pass, 0, entities.materials[i], entities.meshes[i], depth);
+            item.index = static_cast<unsigned int>(list.draws.size());
+            list.items.push_back(item);
+            list.draws.push_back(draw);
+            list.entities.push_back(i);
+        }
+    };
+    if (jobs && numChunks > 1)
+        jobs->parallelFor(0, numChunks, [&](unsigned int firstChunk, unsigned int lastChunk)
+        {
+            for (unsigned int c = firstChunk; c < lastChunk; c++)
+                buildChunk(c);
+        }, 1);
+    else
+        for (unsigned int c = 0; c < numChunks; c++)
+            buildChunk(c);
+    cullMilliseconds = millisecondsSince(start);
+
+    // Concatenate the lists, offsetting each chunk's draw indices by its position
+    start = std::chrono::high_resolution_clock::now();
+    offsets.resize(numChunks + 1);
+    offsets[0] = 0;
+    for (unsigned int c = 0; c < numChunks; c++)
+        offsets[c + 1] = offsets[c] + static_cast<unsigned int>(lists[c].items.size());
+    queue.items.resize(offsets[numChunks]);
+    draws.resize(offsets[numChunks]);
+    entityIndices.resize(offsets[numChunks]);
+    auto mergeChunk = [&](const unsigned int c)
+    {
+        const CommandList &list = lists[c];
+        unsigned int offset = offsets[c];
+        for (unsigned int k = 0; k < list.items.size(); k++)
+        {
+            queue.items[offset + k].key = list.items[k].key;
+            queue.items[offset + k].index = list.items[k].index + offset;
+        }
+        std::copy(list.draws.begin(), list.draws.end(), draws.begin() + offset);
+        std::copy(list.entities.begin(), list.entities.end(), entityIndices.begin() + offset);
+    };
+    if (jobs && numChunks > 1)
+        jobs->parallelFor(0, numChunks, [&](unsigned int firstChunk, unsigned int lastChunk)
+        {
+            for (unsigned int c = firstChunk; c < lastChunk; c++)
+                mergeChunk(c);
+        }, 1);
+    else
+        for (unsigned int c = 0; c < numChunks; c++)
+            mergeChunk(c);
+    mergeMilliseconds = millisecondsSince(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    queue.jobs = jobs;
+    queue.sort();
+    sortMilliseconds = millisecondsSince(start);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <common/culling.hpp>
+#include <common/entity.hpp>
+#include <common/renderqueue.hpp>
+
+class JobSystem;
+
+// Per-draw data streamed to the object uniform block, laid out like ObjectUniforms
+struct DrawData
+{
+    glm::mat4 MVP;
+    glm::mat4 MV;
+};
+
+// Builds the frame's sorted draws from the entity store. The entities are
+// split into chunks and each job culls its chunk, computes the matrices and
+// writes sort keys and draw data into its own command list. The lists are
+// then merged and the keys sorted, leaving only the GL submission for the
+// context thread. Item k of the queue draws with draws[queue.items[k].index].
+class DrawList
+{
+public:
+    RenderQueue queue;
+    std::vector<DrawData> draws;
+
+    // Entity index of each draw
+    std::vector<unsigned int> entityIndices;
+
+    // Statistics for the last build in milliseconds
+    float cullMilliseconds = 0.0f;
+    float mergeMilliseconds = 0.0f;
+    float sortMilliseconds = 0.0f;
+
+    // Chunks are built and sorted as jobs when set
+    JobSystem *jobs = NULL;
+
+    // Build the draws of the visible entities, or of every entity inside the
+    // frustum when visible is NULL, skipping entities with any of skipFlags
+    void build(EntityStore &entities, const std::vector<unsigned int> *visible,
+               const glm::mat4 &view, const glm::mat4 &projection, const float near, const float far,
+               const float minSize, const unsigned char skipFlags);
+
+private:
+    // Thread-local output of one chunk, item indices are local to the chunk
+    struct CommandList
+    {
+        std::vector<RenderItem> items;
+        std::vector<DrawData> draws;
+        std::vector<unsigned int> entities;
+        std::vector<unsigned int> visible;
+    };
+
+    std::vector<CommandList> lists;
+    std::vector<unsigned int> offsets;
+};
@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <cmath>
+
+#include <common/dynamicresolution.hpp>
+
+DynamicResolution::DynamicResolution(const float budgetMilliseconds)
+{
+    this->budgetMilliseconds = budgetMilliseconds;
+}
+
+void DynamicResolution::update(const float gpuMilliseconds, const float measuredScale)
+{
+    if (gpuMilliseconds <= 0.0f || measuredScale <= 0.0f)
+        return;
+
+    // Exponential average of the full resolution cost, seeded by the first measurement
+    float full = gpuMilliseconds / (measuredScale * measuredScale);
+    fullMilliseconds = fullMilliseconds > 0.0f ? fullMilliseconds + 0.1f * (full - fullMilliseconds) : full;
+    smoothedMilliseconds = fullMilliseconds * scale * scale;
+
+    // Measurements lag a few frames behind, wait for the last change to show up in them
+    framesSinceChange++;
+    if (framesSinceChange < cooldownFrames)
+        return;
+
+    // Scale at which the frame would take exactly the budget
+    float ideal = sqrtf(budgetMilliseconds / fullMilliseconds);
+    float target = scale;
+    if (ideal < scale)
+        target = std::max(floorf(ideal / step) * step, scale - maxStepsDown * step);
+    else if (ideal > scale + 1.5f * step)
+        target = scale + step;
+    target = std::min(std::max(target, minScale), maxScale);
+
+    if (fabsf(target - scale) > 0.5f * step)
+    {
+        scale = target;
+        smoothedMilliseconds = fullMilliseconds * scale * scale;
+        framesSinceChange = 0;
+        numChanges++;
+    }
+}
+
+void DynamicResolution::reset()
+{
+    scale = maxScale;
+    fullMilliseconds = 0.0f;
+    smoothedMilliseconds = 0.0f;
+    framesSinceChange = 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Picks the fraction of the output resolution the scene is rendered at so
+// that the measured GPU time stays within a budget. Frame cost is modelled
+// as proportional to the rendered pixels, i.e. to the scale squared, and
+// the measurements are normalised to full resolution before smoothing so
+// frames drawn at different scales agree. The scale moves in fixed steps,
+// drops as soon as the smoothed time is over budget and only rises with a
+// step's worth of headroom, so it settles instead of hunting around the
+// budget; the temporal upscaler hides the remaining steps.
+class DynamicResolution
+{
+public:
+    // GPU time per frame to aim for and the range of the scale
+    float budgetMilliseconds;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+
+    // Size of a scale change, frames between changes and the largest drop in steps
+    float step = 0.05f;
+    unsigned int cooldownFrames = 8;
+    unsigned int maxStepsDown = 2;
+
+    // Current scale
+    float scale = 1.0f;
+
+    // Statistics
+    float smoothedMilliseconds = 0.0f;
+    unsigned int numChanges = 0;
+
+    // Constructor
+    DynamicResolution(const float budgetMilliseconds);
+
+    // Feed the GPU time measured for a frame rendered at the given scale
+    void update(const float gpuMilliseconds, const float measuredScale);
+
+    // Forget the measurements and return to full scale
+    void reset();
+
+private:
+    // Smoothed time of a full resolution frame
+    float fullMilliseconds = 0.0f;
+    unsigned int framesSinceChange = 0;
+};
@@ -0,0 +1,147 @@
+#include <stdio.h>
+
+#include <common/entity.hpp>
+
+static const uint32_t slotBits = 24;
+static const uint32_t slotMask = (1u << slotBits) - 1;
+
+Entity EntityStore::create(const glm::vec3 &position, const float angle, const glm::vec3 &axis, const glm::vec3 &scale,
+                           const int mesh, const int material, const AABB &localBox,
+                           const unsigned char flags, const int parent)
+{
+    // Reuse a free slot or add one
+    uint32_t slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        if (slotIndices.size() > slotMask)
+        {
+            printf("Entity store is full\n");
+            return nullEntity;
+        }
+        slot = static_cast<uint32_t>(slotIndices.size());
+        slotIndices.push_back(0);
+        generations.push_back(0);
+    }
+
+    unsigned int i = size();
+    slotIndices[slot] = i;
+    Entity entity = (static_cast<uint32_t>(generations[slot]) << slotBits) | slot;
+
+    positions.push_back(position);
+    rotations.push_back(Maths::axisAngle(angle, axis));
+    scales.push_back(scale);
+    parents.push_back(parent);
+    meshes.push_back(mesh);
+    materials.push_back(material);
+    this->flags.push_back(flags);
+    worlds.push_back(glm::mat4(1.0f));
+    localBounds.push_back(localBox);
+    bounds.add(localBox);
+    handles.push_back(entity);
+    dirty.push_back(0);
+    markDirty(i);
+
+    return entity;
+}
+
+void EntityStore::destroy(const Entity entity)
+{
+    int i = index(entity);
+    if (i == -1)
+        return;
+
+    // Move the last entity into the hole
+    unsigned int last = size() - 1;
+    if (static_cast<unsigned int>(i) != last)
+    {
+        positions[i] = positions[last];
+        rotations[i] = rotations[last];
+        scales[i] = scales[last];
+        parents[i] = parents[last];
+        meshes[i] = meshes[last];
+        materials[i] = materials[last];
+        flags[i] = flags[last];
+        worlds[i] = worlds[last];
+        localBounds[i] = localBounds[last];
+        bounds.set(i, bounds.box(last));
+        handles[i] = handles[last];
+        dirty[i] = dirty[last];
+        slotIndices[handles[i] & slotMask] = i;
+    }
+    positions.pop_back();
+    rotations.pop_back();
+    scales.pop_back();
+    parents.pop_back();
+    meshes.pop_back();
+    materials.pop_back();
+    flags.pop_back();
+    worlds.pop_back();
+    localBounds.pop_back();
+    bounds.removeLast();
+    handles.pop_back();
+    dirty.pop_back();
+
+    // Invalidate old handles to the slot
+    uint32_t slot = entity & slotMask;
+    generations[slot]++;
+    freeSlots.push_back(slot);
+}
+
+int EntityStore::index(const Entity entity)
+{
+    uint32_t slot = entity & slotMask;
+    if (entity == nullEntity || slot >= slotIndices.size() || generations[slot] != (entity >> slotBits))
+        return -1;
+    return static_cast<int>(slotIndices[slot]);
+}
+
+bool EntityStore::alive(const Entity entity)
+{
+    return index(entity) != -1;
+}
+
+unsigned int EntityStore::size()
+{
+    return static_cast<unsigned int>(handles.size());
+}
+
+void EntityStore::markDirty(const unsigned int i)
+{
+    if (dirty[i])
+        return;
+    dirty[i] = 1;
+    dirtyEntities.push_back(handles[i]);
+}
+
+void EntityStore::updateTransforms(TransformHierarchy &hierarchy, std::vector<unsigned int> &changed)
+{
+    // Children of moved hierarchy transforms, found with one pass over the parent array
+    if (hierarchy.numUpdated > 0)
+    {
+        unsigned int n = size();
+        for (unsigned int i = 0; i < n; i++)
+            if (parents[i] != -1 && hierarchy.wasChanged(parents[i]))
+                markDirty(i);
+    }
+
+    // The dirty list holds handles so that it survives entities being destroyed
+    for (unsigned int d = 0; d < dirtyEntities.size(); d++)
+    {
+        int i = index(dirtyEntities[d]);
+        if (i == -1 || !dirty[i])
+            continue;
+        dirty[i] = 0;
+
+        worlds[i] = Maths::transform(positions[i], rotations[i], scales[i]);
+        if (parents[i] != -1)
+            worlds[i] = hierarchy.world(parents[i]) * worlds[i];
+        bounds.set(i, Maths::transformAABB(localBounds[i], worlds[i]));
+        changed.push_back(i);
+    }
+    dirtyEntities.clear();
+}
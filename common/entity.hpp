@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+#include <common/maths.hpp>
+#include <common/culling.hpp>
+#include <common/transform.hpp>
+
+// Entity handle, the low 24 bits are a slot and the high 8 bits the slot's
+// generation so that handles to destroyed entities are detected
+typedef uint32_t Entity;
+const Entity nullEntity = 0xffffffffu;
+
+// Entity flags
+const unsigned char EntityStatic = 1;
+const unsigned char EntityOccluder = 2;
+const unsigned char EntityTransparent = 4;
+
+// Entities stored as dense structure-of-arrays components. Index i of every
+// array belongs to the same entity and destroying an entity moves the last
+// one into its place, so systems loop over packed arrays with no gaps. Dense
+// indices change when entities are destroyed, handles do not.
+class EntityStore
+{
+public:
+    // Local transform
+    std::vector<glm::vec3> positions;
+    std::vector<Quaternion> rotations;
+    std::vector<glm::vec3> scales;
+
+    // Parent transform in the hierarchy or -1
+    std::vector<int> parents;
+
+    // Rendering
+    std::vector<int> meshes;
+    std::vector<int> materials;
+    std::vector<unsigned char> flags;
+
+    // World matrices and object and world space bounds
+    std::vector<glm::mat4> worlds;
+    std::vector<AABB> localBounds;
+    BoundsArray bounds;
+
+    // Handle of each entity
+    std::vector<Entity> handles;
+
+    // Create an entity, its world matrix and bounds are set by the next updateTransforms
+    Entity create(const glm::vec3 &position, const float angle, const glm::vec3 &axis, const glm::vec3 &scale,
+                  const int mesh, const int material, const AABB &localBox,
+                  const unsigned char flags = 0, const int parent = -1);
+
+    // Destroy an entity, the last entity moves into its place
+    void destroy(const Entity entity);
+
+    // Dense index of a live entity or -1
+    int index(const Entity entity);
+    bool alive(const Entity entity);
+
+    // Number of live entities
+    unsigned int size();
+
+    // Flag an entity whose local transform was changed through the arrays
+    void markDirty(const unsigned int i);
+
+    // Rebuild the world matrices and bounds of dirty entities and of those whose
+    // parent changed in the hierarchy's last update, appending their indices
+    void updateTransforms(TransformHierarchy &hierarchy, std::vector<unsigned int> &changed);
+
+private:
+    std::vector<uint32_t> slotIndices;
+    std::vector<uint8_t> generations;
+    std::vector<uint32_t> freeSlots;
+    std::vector<unsigned char> dirty;
+    std::vector<Entity> dirtyEntities;
+};
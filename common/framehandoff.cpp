@@ -0,0 +1,65 @@
+#include <thread>
+#include <chrono>
+
+#include <common/framehandoff.hpp>
+
+// Spin briefly before sleeping, a frame is usually handed over within microseconds
+static void backOff(unsigned int &spins)
+{
+    if (++spins < 64)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+FrameHandoff::FrameHandoff()
+{
+    states[0] = Free;
+    states[1] = Free;
+    stopping = false;
+}
+
+int FrameHandoff::beginWrite()
+{
+    unsigned int spins = 0;
+    while (states[writeIndex].load(std::memory_order_acquire) != Free)
+        backOff(spins);
+    return writeIndex;
+}
+
+void FrameHandoff::endWrite()
+{
+    states[writeIndex].store(Published, std::memory_order_release);
+    writeIndex ^= 1;
+}
+
+int FrameHandoff::beginRead()
+{
+    unsigned int spins = 0;
+    while (states[readIndex].load(std::memory_order_acquire) != Published)
+    {
+        if (stopping.load(std::memory_order_acquire) && states[readIndex].load(std::memory_order_acquire) != Published)
+            return -1;
+        backOff(spins);
+    }
+    states[readIndex].store(Reading, std::memory_order_relaxed);
+    return readIndex;
+}
+
+void FrameHandoff::endRead()
+{
+    states[readIndex].store(Free, std::memory_order_release);
+    readIndex ^= 1;
+}
+
+void FrameHandoff::waitIdle()
+{
+    unsigned int spins = 0;
+    while (states[0].load(std::memory_order_acquire) != Free || states[1].load(std::memory_order_acquire) != Free)
+        backOff(spins);
+}
+
+void FrameHandoff::stop()
+{
+    stopping.store(true, std::memory_order_release);
+}
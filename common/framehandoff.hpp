@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free double buffer handing frame packets from one producer thread to
+// one consumer thread. The caller owns two packets and the hand-off says
+// which one each side may touch: the producer fills one while the consumer
+// reads the other, so the producer runs at most one frame ahead.
+class FrameHandoff
+{
+public:
+    FrameHandoff();
+
+    // Producer, index of the packet to fill, waits until the consumer has released it
+    int beginWrite();
+
+    // Producer, publish the packet filled since beginWrite
+    void endWrite();
+
+    // Consumer, index of the next published packet, waits for it and returns -1 once stopped
+    int beginRead();
+
+    // Consumer, release the packet read since beginRead
+    void endRead();
+
+    // Producer, wait until the consumer has released every published packet
+    void waitIdle();
+
+    // Producer, beginRead returns -1 once the published packets have been read
+    void stop();
+
+private:
+    enum State { Free, Published, Reading };
+
+    std::atomic<int> states[2];
+    std::atomic<bool> stopping;
+    int writeIndex = 0;
+    int readIndex = 0;
+};
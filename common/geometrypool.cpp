@@ -0,0 +1,254 @@
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <unordered_map>
+
+#include <common/geometrypool.hpp>
+#include <common/materials.hpp>
+
+// Hash of the raw bytes of a vertex, used to weld duplicate vertices
+struct PoolVertexHash
+{
+    size_t operator()(const PoolVertex &v) const
+    {
+        const unsigned int *words = reinterpret_cast<const unsigned int*>(&v);
+        size_t hash = 2166136261u;
+        for (unsigned int i = 0; i < sizeof(PoolVertex) / sizeof(unsigned int); i++)
+            hash = (hash ^ words[i]) * 16777619u;
+        return hash;
+    }
+};
+
+struct PoolVertexEqual
+{
+    bool operator()(const PoolVertex &a, const PoolVertex &b) const
+    {
+        return memcmp(&a, &b, sizeof(PoolVertex)) == 0;
+    }
+};
+
+// Models bind the same material when their textures and parameters match
+static bool sameMaterial(const Model &a, const Model &b)
+{
+    if (a.textures.size() != b.textures.size() || a.ka != b.ka || a.kd != b.kd || a.ks != b.ks || a.Ns != b.Ns)
+        return false;
+    for (unsigned int i = 0; i < a.textures.size(); i++)
+        if (a.textures[i].id != b.textures[i].id || a.textures[i].type != b.textures[i].type)
+            return false;
+    return true;
+}
+
+GeometryPool::GeometryPool(const unsigned int maxVertices, const unsigned int maxIndices)
+{
+    vertexCapacity = maxVertices;
+    indexCapacity = maxIndices;
+    multiDrawIndirect = GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance;
+    printf("Geometry pool: %s submission\n", multiDrawIndirect ? "multi-draw indirect" : "draw loop");
+
+    // Create the shared VAO
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+
+    // Shared vertex buffer
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof(PoolVertex), NULL, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PoolVertex), (void*)offsetof(PoolVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(PoolVertex), (void*)offsetof(PoolVertex, uv));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(PoolVertex), (void*)offsetof(PoolVertex, normal));
+
+    // Shared index buffer (element array binding is stored in the VAO)
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+
+    // Per-instance model matrices and material indices, sourced from the stream buffer at submit
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        glEnableVertexAttribArray(5 + i);
+        glVertexAttribDivisor(5 + i, 1);
+    }
+    glEnableVertexAttribArray(materialAttribute);
+    glVertexAttribDivisor(materialAttribute, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+int GeometryPool::addModel(Model &model)
+{
+    // Weld the model's unindexed triangle list into unique vertices and indices
+    std::vector<PoolVertex> vertices;
+    std::vector<unsigned int> indices;
+    std::unordered_map<PoolVertex, unsigned int, PoolVertexHash, PoolVertexEqual> lookup;
+    indices.reserve(model.vertices.size());
+    for (unsigned int i = 0; i < model.vertices.size(); i++)
+    {
+        PoolVertex vertex;
+        vertex.position = model.vertices[i];
+        vertex.uv = model.uvs[i];
+        vertex.normal = model.normals[i];
+
+        auto it = lookup.find(vertex);
+        if (it == lookup.end())
+        {
+            unsigned int index = static_cast<unsigned int>(vertices.size());
+            lookup[vertex] = index;
+            vertices.push_back(vertex);
+            indices.push_back(index);
+        }
+        else
+            indices.push_back(it->second);
+    }
+
+    if (numVertices + vertices.size() > vertexCapacity || numIndices + indices.size() > indexCapacity)
+    {
+        printf("Geometry pool is full, model not added.\n");
+        return -1;
+    }
+
+    // Sub-allocate the mesh at the end of the shared buffers
+    MeshRange mesh;
+    mesh.firstIndex = numIndices;
+    mesh.indexCount = static_cast<unsigned int>(indices.size());
+    mesh.baseVertex = static_cast<int>(numVertices);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, numVertices * sizeof(PoolVertex), vertices.size() * sizeof(PoolVertex), &vertices[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(VAO);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), indices.size() * sizeof(unsigned int), &indices[0]);
+    glBindVertexArray(0);
+
+    numVertices += static_cast<unsigned int>(vertices.size());
+    numIndices += mesh.indexCount;
+    meshes.push_back(mesh);
+    meshInstances.push_back(std::vector<glm::mat4>());
+    meshMaterials.push_back(std::vector<int>());
+
+    // Group the mesh with the first one binding the same material
+    unsigned int group = static_cast<unsigned int>(meshModels.size());
+    for (unsigned int i = 0; i < meshModels.size() && group == meshModels.size(); i++)
+        if (sameMaterial(*meshModels[i], model))
+            group = materialGroups[i];
+    meshModels.push_back(&model);
+    materialGroups.push_back(group);
+
+    return static_cast<int>(meshes.size()) - 1;
+}
+
+void GeometryPool::addInstance(const unsigned int meshID, const glm::mat4 &modelMatrix, const int material)
+{
+    meshInstances[meshID].push_back(modelMatrix);
+    meshMaterials[meshID].push_back(material);
+}
+
+void GeometryPool::submit(unsigned int &shaderID, StreamBuffer &streamBuffer, const bool tableMaterials)
+{
+    // Meshes sharing a material are adjacent so each group is a contiguous run of commands
+    std::vector<unsigned int> order(meshes.size());
+    for (unsigned int i = 0; i < meshes.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return materialGroups[a] < materialGroups[b]; });
+
+    // Pack instances contiguously and build one command per mesh
+    instances.clear();
+    instanceMaterials.clear();
+    commands.clear();
+    commandGroups.clear();
+    for (unsigned int o = 0; o < order.size(); o++)
+    {
+        unsigned int i = order[o];
+        if (meshInstances[i].empty())
+            continue;
+
+        DrawElementsIndirectCommand command;
+        command.count = meshes[i].indexCount;
+        command.instanceCount = static_cast<unsigned int>(meshInstances[i].size());
+        command.firstIndex = meshes[i].firstIndex;
+        command.baseVertex = meshes[i].baseVertex;
+        command.baseInstance = static_cast<unsigned int>(instances.size());
+        commands.push_back(command);
+        commandGroups.push_back(materialGroups[i]);
+
+        instances.insert(instances.end(), meshInstances[i].begin(), meshInstances[i].end());
+        instanceMaterials.insert(instanceMaterials.end(), meshMaterials[i].begin(), meshMaterials[i].end());
+        meshInstances[i].clear();
+        meshMaterials[i].clear();
+    }
+
+    numInstances = static_cast<unsigned int>(instances.size());
+    drawCalls = 0;
+    if (commands.empty())
+        return;
+
+    // Stream the instance matrices, material indices and commands
+    unsigned int numCommands = static_cast<unsigned int>(commands.size());
+    size_t instanceOffset, materialOffset, commandOffset;
+    if (!streamBuffer.write(&instances[0], numInstances * sizeof(glm::mat4), sizeof(glm::vec4), instanceOffset) ||
+        !streamBuffer.write(&instanceMaterials[0], numInstances * sizeof(int), sizeof(int), materialOffset) ||
+        !streamBuffer.write(&commands[0], numCommands * sizeof(DrawElementsIndirectCommand), sizeof(unsigned int), commandOffset))
+        return;
+    streamBuffer.flush();
+
+    glBindVertexArray(VAO);
+    if (multiDrawIndirect)
+    {
+        // Every mesh in a single call, or a call per run of meshes sharing a material
+        setInstanceOffset(streamBuffer.buffer, instanceOffset, materialOffset);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, streamBuffer.buffer);
+        unsigned int first = 0;
+        while (first < numCommands)
+        {
+            unsigned int last = numCommands;
+            if (!tableMaterials)
+            {
+                last = first + 1;
+                while (last < numCommands && commandGroups[last] == commandGroups[first])
+                    last++;
+                meshModels[commandGroups[first]]->bindMaterial(shaderID);
+            }
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(commandOffset + first * sizeof(DrawElementsIndirectCommand)),
+                                        last - first, 0);
+            drawCalls++;
+            first = last;
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else
+    {
+        // GL 3.3 fallback, base instance is emulated by offsetting the instance attributes
+        for (unsigned int i = 0; i < commands.size(); i++)
+        {
+            if (!tableMaterials && (i == 0 || commandGroups[i] != commandGroups[i - 1]))
+                meshModels[commandGroups[i]]->bindMaterial(shaderID);
+            setInstanceOffset(streamBuffer.buffer, instanceOffset + commands[i].baseInstance * sizeof(glm::mat4),
+                              materialOffset + commands[i].baseInstance * sizeof(int));
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, commands[i].count, GL_UNSIGNED_INT,
+                                              (void*)(commands[i].firstIndex * sizeof(unsigned int)),
+                                              commands[i].instanceCount, commands[i].baseVertex);
+            drawCalls++;
+        }
+    }
+    glBindVertexArray(0);
+}
+
+void GeometryPool::setInstanceOffset(const unsigned int buffer, const size_t offset, const size_t materialOffset)
+{
+    // Assumes the pool's VAO is bound
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (unsigned int i = 0; i < 4; i++)
+        glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + i * sizeof(glm::vec4)));
+    glVertexAttribIPointer(materialAttribute, 1, GL_INT, sizeof(int), (void*)materialOffset);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryPool::deleteBuffers()
+{
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteVertexArrays(1, &VAO);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/model.hpp>
+#include <common/streambuffer.hpp>
+
+// Indirect draw command layout expected by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+// Location of a mesh inside the shared buffers
+struct MeshRange
+{
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+};
+
+// Interleaved vertex stored in the shared vertex buffer
+struct PoolVertex
+{
+    glm::vec3 position;
+    glm::vec2 uv;
+    glm::vec3 normal;
+};
+
+class GeometryPool
+{
+public:
+    std::vector<MeshRange> meshes;
+
+    // Draw statistics for the last submit
+    unsigned int drawCalls = 0;
+    unsigned int numInstances = 0;
+
+    // Constructor
+    GeometryPool(const unsigned int maxVertices, const unsigned int maxIndices);
+
+    // Add a model to the pool, its material is bound for its meshes. Returns the mesh ID
+    // or -1 if the pool is full.
+    int addModel(Model &model);
+
+    // Queue an instance of a mesh for the current frame with its material table row
+    void addInstance(const unsigned int meshID, const glm::mat4 &modelMatrix, const int material = 0);
+
+    // Stream the frame's instances and commands and draw every mesh. Programs reading the
+    // material table take each instance's row and draw everything in one call, for the
+    // others the meshes are grouped by their model's material with one call per group.
+    void submit(unsigned int &shaderID, StreamBuffer &streamBuffer, const bool tableMaterials);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    unsigned int VAO;
+    unsigned int vertexBuffer;
+    unsigned int indexBuffer;
+    unsigned int vertexCapacity, indexCapacity;
+    unsigned int numVertices = 0, numIndices = 0;
+    bool multiDrawIndirect;
+
+    // Model of each mesh and the first mesh sharing its material
+    std::vector<Model*> meshModels;
+    std::vector<unsigned int> materialGroups;
+
+    // Per-mesh instance lists and the packed per-frame arrays
+    std::vector<std::vector<glm::mat4> > meshInstances;
+    std::vector<std::vector<int> > meshMaterials;
+    std::vector<glm::mat4> instances;
+    std::vector<int> instanceMaterials;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<unsigned int> commandGroups;
+
+    // Point the instance attributes at the given byte offsets of a buffer
+    void setInstanceOffset(const unsigned int buffer, const size_t offset, const size_t materialOffset);
+};
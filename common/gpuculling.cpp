@@ -0,0 +1,269 @@
+#include <cmath>
+#include <cstddef>
+#include <stdio.h>
+#include <algorithm>
+
+#include <common/gpuculling.hpp>
+#include <common/culling.hpp>
+#include <common/shader.hpp>
+
+// Culling input layout, one vertex per instance
+struct CullInstance
+{
+    glm::mat4 model;
+    glm::vec4 centre;
+    glm::vec4 extent;
+};
+
+GPUCuller::GPUCuller(const int width, const int height, const unsigned int maxInstances)
+{
+    this->width = width;
+    this->height = height;
+    this->maxInstances = maxInstances;
+    queryBuffer = GLEW_ARB_query_buffer_object && GLEW_ARB_draw_indirect;
+    printf("GPU culling: visible count %s\n", queryBuffer ? "written by query buffer" : "from previous query");
+
+    // Programs
+    const char* varyings[] = { "column0", "column1", "column2", "column3" };
+    cullShaderID = LoadTransformFeedbackShaders("cullVertexShader.glsl", "cullGeometryShader.glsl", varyings, 4);
+    hiZShaderID = LoadShaders("fullscreenVertexShader.glsl", "hiZFragmentShader.glsl");
+
+    // Input buffer and its VAO
+    glGenVertexArrays(1, &inputVAO);
+    glBindVertexArray(inputVAO);
+    glGenBuffers(1, &inputBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, inputBuffer);
+    glBufferData(GL_ARRAY_BUFFER, maxInstances * sizeof(CullInstance), NULL, GL_STATIC_DRAW);
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        glEnableVertexAttribArray(i);
+        glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, sizeof(CullInstance), (void*)(i * sizeof(glm::vec4)));
+    }
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(CullInstance), (void*)offsetof(CullInstance, centre));
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(CullInstance), (void*)offsetof(CullInstance, extent));
+    glBindVertexArray(0);
+
+    // Compacted outputs, one per result in flight
+    glGenBuffers(numResults, outputBuffers);
+    glGenQueries(numResults, queries);
+    for (unsigned int i = 0; i < numResults; i++)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, outputBuffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, maxInstances * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+        resultCounts[i] = 0;
+        resultPending[i] = false;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Indirect command whose instance count is filled in by the GPU
+    unsigned int command[4] = { 0, 0, 0, 0 };
+    glGenBuffers(1, &indirectBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), command, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    // Depth copy target
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenFramebuffers(1, &depthFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    // Max-depth pyramid with one framebuffer per level
+    hiZLevels = 1 + static_cast<int>(floor(log2(static_cast<float>(std::max(width, height)))));
+    glGenTextures(1, &hiZTexture);
+    glBindTexture(GL_TEXTURE_2D, hiZTexture);
+    for (int level = 0; level < hiZLevels; level++)
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(1, width >> level), std::max(1, height >> level), 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    hiZFBOs.resize(hiZLevels);
+    glGenFramebuffers(hiZLevels, &hiZFBOs[0]);
+    for (int level = 0; level < hiZLevels; level++)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, hiZFBOs[level]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, hiZTexture, level);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenVertexArrays(1, &emptyVAO);
+}
+
+void GPUCuller::setInstances(const std::vector<glm::mat4> &modelMatrices, const std::vector<AABB> &bounds)
+{
+    numInstances = std::min(static_cast<unsigned int>(modelMatrices.size()), maxInstances);
+    std::vector<CullInstance> instances(numInstances);
+    for (unsigned int i = 0; i < numInstances; i++)
+    {
+        instances[i].model = modelMatrices[i];
+        instances[i].centre = glm::vec4(0.5f * (bounds[i].min + bounds[i].max), 0.0f);
+        instances[i].extent = glm::vec4(0.5f * (bounds[i].max - bounds[i].min), 0.0f);
+    }
+
+    if (numInstances > 0)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, inputBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, numInstances * sizeof(CullInstance), &instances[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+void GPUCuller::cull(const glm::mat4 &viewProjection)
+{
+    unsigned int result = frame % numResults;
+    frame++;
+
+    // Culling uniforms
+    Frustum frustum(viewProjection);
+    glUseProgram(cullShaderID);
+    glUniform4fv(glGetUniformLocation(cullShaderID, "frustumPlanes"), 6, &frustum.planes[0][0]);
+    glUniform1i(glGetUniformLocation(cullShaderID, "useHiZ"), hiZValid);
+    hiZValid = false;
+    glUniformMatrix4fv(glGetUniformLocation(cullShaderID, "previousVP"), 1, GL_FALSE, &hiZViewProjection[0][0]);
+    glUniform2f(glGetUniformLocation(cullShaderID, "hiZSize"), static_cast<float>(width), static_cast<float>(height));
+    glUniform1i(glGetUniformLocation(cullShaderID, "hiZLevels"), hiZLevels);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hiZTexture);
+    glUniform1i(glGetUniformLocation(cullShaderID, "hiZMap"), 0);
+
+    // Points in, compacted visible matrices out, nothing rasterized
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, outputBuffers[result]);
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, queries[result]);
+    glBeginTransformFeedback(GL_POINTS);
+    glBindVertexArray(inputVAO);
+    glDrawArrays(GL_POINTS, 0, numInstances);
+    glBindVertexArray(0);
+    glEndTransformFeedback();
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    resultPending[result] = true;
+
+    if (queryBuffer)
+    {
+        // The GPU copies the query result into the command's instance count
+        drawResult = result;
+        glBindBuffer(GL_QUERY_BUFFER, indirectBuffer);
+        glGetQueryObjectuiv(queries[result], GL_QUERY_RESULT, (GLuint*)(sizeof(unsigned int)));
+        glBindBuffer(GL_QUERY_BUFFER, 0);
+    }
+
+    // Collect the counts of earlier results that are ready without waiting
+    for (unsigned int i = 0; i < numResults; i++)
+    {
+        if (!resultPending[i] || i == result)
+            continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT, &resultCounts[i]);
+            resultPending[i] = false;
+        }
+    }
+    for (unsigned int age = 1; age < numResults; age++)
+    {
+        unsigned int candidate = (result + numResults - age) % numResults;
+        if (!resultPending[candidate] && frame > age)
+        {
+            // Otherwise draw the newest result whose count is known
+            if (!queryBuffer)
+                drawResult = candidate;
+            numVisible = resultCounts[candidate];
+            break;
+        }
+    }
+}
+
+void GPUCuller::draw(unsigned int &shaderID, Model &model)
+{
+    if (drawResult < 0)
+        return;
+
+    glUseProgram(shaderID);
+    if (queryBuffer)
+    {
+        // Only the vertex count comes from the CPU, the instance count was written by the cull
+        unsigned int count = static_cast<unsigned int>(model.vertices.size());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(unsigned int), &count);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        model.drawIndirect(shaderID, outputBuffers[drawResult], indirectBuffer);
+    }
+    else
+        model.drawInstanced(shaderID, outputBuffers[drawResult], 0, numVisible);
+}
+
+void GPUCuller::buildHiZ(const glm::mat4 &viewProjection, const unsigned int framebuffer)
+{
+    // Copy the resolved depth of the scene framebuffer
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFBO);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    glUseProgram(hiZShaderID);
+    glBindVertexArray(emptyVAO);
+    glDisable(GL_DEPTH_TEST);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(hiZShaderID, "depthMap"), 0);
+
+    // Level 0 copies the depth texture
+    glBindFramebuffer(GL_FRAMEBUFFER, hiZFBOs[0]);
+    glViewport(0, 0, width, height);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glUniform1i(glGetUniformLocation(hiZShaderID, "copyDepth"), 1);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    // Each further level reduces the one above, sampling is limited to that level
+    glBindTexture(GL_TEXTURE_2D, hiZTexture);
+    glUniform1i(glGetUniformLocation(hiZShaderID, "copyDepth"), 0);
+    for (int level = 1; level < hiZLevels; level++)
+    {
+        int previousWidth = std::max(1, width >> (level - 1)), previousHeight = std::max(1, height >> (level - 1));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        glUniform2i(glGetUniformLocation(hiZShaderID, "previousSize"), previousWidth, previousHeight);
+        glBindFramebuffer(GL_FRAMEBUFFER, hiZFBOs[level]);
+        glViewport(0, 0, std::max(1, width >> level), std::max(1, height >> level));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, hiZLevels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Restore state
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+    glBindVertexArray(0);
+
+    hiZViewProjection = viewProjection;
+    hiZValid = true;
+}
+
+void GPUCuller::deleteBuffers()
+{
+    glDeleteBuffers(1, &inputBuffer);
+    glDeleteBuffers(numResults, outputBuffers);
+    glDeleteBuffers(1, &indirectBuffer);
+    glDeleteQueries(numResults, queries);
+    glDeleteVertexArrays(1, &inputVAO);
+    glDeleteVertexArrays(1, &emptyVAO);
+    glDeleteFramebuffers(1, &depthFBO);
+    glDeleteFramebuffers(hiZLevels, &hiZFBOs[0]);
+    glDeleteTextures(1, &depthTexture);
+    glDeleteTextures(1, &hiZTexture);
+    glDeleteProgram(cullShaderID);
+    glDeleteProgram(hiZShaderID);
+}
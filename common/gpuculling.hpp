@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/maths.hpp>
+#include <common/model.hpp>
+
+// GPU instance culling. A transform feedback pass tests every instance's
+// bounds against the frustum and against a max-depth pyramid built from
+// the previous frame's depth buffer, and writes the model matrices of the
+// visible instances into a compacted buffer that the instanced draw reads.
+// With ARB_query_buffer_object the visible count is written straight into
+// an indirect draw command, otherwise the most recent available query
+// result is used so the CPU never waits for the GPU.
+class GPUCuller
+{
+public:
+    // Visible count of the newest result known on the CPU, may lag a frame or two
+    unsigned int numVisible = 0;
+    unsigned int numInstances = 0;
+
+    // Constructor, the pyramid matches the default framebuffer size
+    GPUCuller(const int width, const int height, const unsigned int maxInstances);
+
+    // Upload the instances and their world space bounds
+    void setInstances(const std::vector<glm::mat4> &modelMatrices, const std::vector<AABB> &bounds);
+
+    // Run the culling pass for this frame
+    void cull(const glm::mat4 &viewProjection);
+
+    // Draw the visible instances of a model
+    void draw(unsigned int &shaderID, Model &model);
+
+    // Capture the scene framebuffer's depth and build the pyramid for next frame's cull
+    void buildHiZ(const glm::mat4 &viewProjection, const unsigned int framebuffer = 0);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    static const unsigned int numResults = 3;
+
+    int width, height, hiZLevels;
+    unsigned int maxInstances;
+    bool queryBuffer;
+    bool hiZValid = false;
+    glm::mat4 hiZViewProjection;
+
+    // Programs
+    unsigned int cullShaderID;
+    unsigned int hiZShaderID;
+
+    // Culling input and compacted outputs
+    unsigned int inputVAO, inputBuffer;
+    unsigned int outputBuffers[numResults];
+    unsigned int queries[numResults];
+    unsigned int resultCounts[numResults];
+    bool resultPending[numResults];
+    unsigned int indirectBuffer;
+    unsigned int frame = 0;
+    int drawResult = -1;
+
+    // Depth copy and pyramid
+    unsigned int depthFBO, depthTexture;
+    unsigned int hiZTexture;
+    std::vector<unsigned int> hiZFBOs;
+    unsigned int emptyVAO;
+};
@@ -0,0 +1,237 @@
+#include <algorithm>
+
+#include <common/jobsystem.hpp>
+
+// Each thread's deque index for the job system it belongs to
+static thread_local JobSystem *currentSystem = NULL;
+static thread_local int currentIndex = -1;
+
+// Deque
+JobSystem::Deque::Deque() : top(0), bottom(0)
+{
+    for (int64_t i = 0; i < capacity; i++)
+        jobs[i].store(NULL, std::memory_order_relaxed);
+}
+
+bool JobSystem::Deque::push(Job *job)
+{
+    // Owner only
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= capacity)
+        return false;
+
+    jobs[b & (capacity - 1)].store(job, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+JobSystem::Job *JobSystem::Deque::pop()
+{
+    // Owner only, takes the newest job
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_seq_cst);
+
+    if (t > b)
+    {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return NULL;
+    }
+
+    Job *job = jobs[b & (capacity - 1)].load(std::memory_order_relaxed);
+    if (t == b)
+    {
+        // Last job, race the thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = NULL;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job *JobSystem::Deque::steal()
+{
+    // Any thread, takes the oldest job
+    int64_t t = top.load(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_seq_cst);
+    if (t >= b)
+        return NULL;
+
+    Job *job = jobs[t & (capacity - 1)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return NULL;
+    return job;
+}
+
+// Job system
+JobSystem::JobSystem(unsigned int numThreads) : numStolen(0), stopping(false), numQueued(0)
+{
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Deque 0 belongs to the creating thread
+    for (unsigned int i = 0; i < numThreads; i++)
+        deques.push_back(new Deque());
+    currentSystem = this;
+    currentIndex = 0;
+
+    for (unsigned int i = 1; i < numThreads; i++)
+        workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    for (unsigned int i = 0; i < deques.size(); i++)
+        delete deques[i];
+    if (currentSystem == this)
+    {
+        currentSystem = NULL;
+        currentIndex = -1;
+    }
+}
+
+unsigned int JobSystem::size()
+{
+    return static_cast<unsigned int>(deques.size());
+}
+
+int JobSystem::threadIndex()
+{
+    return currentSystem == this ? currentIndex : -1;
+}
+
+void JobSystem::run(const std::function<void()> &job, JobCounter &counter, JobCounter *dependency)
+{
+    counter.count++;
+
+    Job *newJob = new Job();
+    newJob->function = job;
+    newJob->counter = &counter;
+    newJob->dependency = dependency;
+
+    // Run it now if this thread has no deque or the deque is full
+    int index = threadIndex();
+    if (index == -1 || !deques[index]->push(newJob))
+    {
+        execute(newJob);
+        return;
+    }
+
+    numQueued++;
+    if (!workers.empty())
+        wake.notify_one();
+}
+
+void JobSystem::wait(JobCounter &counter)
+{
+    int index = threadIndex();
+    while (counter.count.load(std::memory_order_acquire) > 0)
+    {
+        Job *job = index == -1 ? NULL : findJob(index);
+        if (job)
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::parallelFor(const unsigned int begin, const unsigned int end,
+                            const std::function<void(unsigned int, unsigned int)> &body,
+                            unsigned int grainSize)
+{
+    if (end <= begin)
+        return;
+
+    unsigned int count = end - begin;
+    if (grainSize == 0)
+        grainSize = std::max(1u, count / (8 * size()));
+
+    // A single range runs on this thread
+    if (count <= grainSize || threadIndex() == -1)
+    {
+        body(begin, end);
+        return;
+    }
+
+    // Queue all but the first range and run that one here
+    JobCounter counter;
+    for (unsigned int first = begin + grainSize; first < end; first += grainSize)
+    {
+        unsigned int last = std::min(end, first + grainSize);
+        run([&body, first, last]() { body(first, last); }, counter);
+    }
+    body(begin, begin + grainSize);
+    wait(counter);
+}
+
+JobSystem::Job *JobSystem::findJob(const int index)
+{
+    Job *job = deques[index]->pop();
+    if (job)
+    {
+        numQueued--;
+        return job;
+    }
+
+    // Steal, starting from the next thread round so threads spread out
+    unsigned int n = size();
+    for (unsigned int i = 1; i < n; i++)
+    {
+        job = deques[(index + i) % n]->steal();
+        if (job)
+        {
+            numQueued--;
+            numStolen++;
+            return job;
+        }
+    }
+    return NULL;
+}
+
+void JobSystem::execute(Job *job)
+{
+    // Help with other jobs until the dependency is complete
+    if (job->dependency)
+        wait(*job->dependency);
+
+    job->function();
+    job->counter->count.fetch_sub(1, std::memory_order_release);
+    delete job;
+}
+
+void JobSystem::workerLoop(const int index)
+{
+    currentSystem = this;
+    currentIndex = index;
+
+    unsigned int idle = 0;
+    while (!stopping)
+    {
+        Job *job = findJob(index);
+        if (job)
+        {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+
+        // Spin briefly before sleeping
+        if (++idle < 64)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait_for(lock, std::chrono::milliseconds(1), [this]() { return stopping || numQueued > 0; });
+        idle = 0;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdint.h>
+
+// Counts unfinished jobs, a job added with a counter increments it and
+// decrements it when it has run
+struct JobCounter
+{
+    std::atomic<int> count;
+
+    JobCounter() : count(0) {}
+};
+
+// Job system with a fixed pool of worker threads. Every thread owns a
+// lock-free work-stealing deque, it pushes and pops jobs at the bottom of
+// its own deque and idle threads steal from the top of the others. The
+// thread that created the system takes part whenever it waits. Jobs may only
+// be added from that thread or from inside jobs, other threads run them
+// immediately.
+class JobSystem
+{
+public:
+    // Statistics, jobs taken from another thread's deque
+    std::atomic<unsigned int> numStolen;
+
+    // Constructor, numThreads includes the calling thread, 0 uses one per hardware thread
+    JobSystem(unsigned int numThreads = 0);
+    ~JobSystem();
+
+    // Number of threads running jobs, including the calling thread
+    unsigned int size();
+
+    // Add a job, it does not start before the dependency counter reaches zero
+    void run(const std::function<void()> &job, JobCounter &counter, JobCounter *dependency = NULL);
+
+    // Run jobs until the counter reaches zero
+    void wait(JobCounter &counter);
+
+    // Call body(first, last) over sub-ranges of [begin, end) in parallel and wait for
+    // them, a grain size of 0 gives every thread several ranges to balance the load
+    void parallelFor(const unsigned int begin, const unsigned int end,
+                     const std::function<void(unsigned int, unsigned int)> &body,
+                     unsigned int grainSize = 0);
+
+private:
+    struct Job
+    {
+        std::function<void()> function;
+        JobCounter *counter;
+        JobCounter *dependency;
+    };
+
+    // Chase-Lev deque with a fixed capacity
+    class Deque
+    {
+    public:
+        Deque();
+        bool push(Job *job);
+        Job *pop();
+        Job *steal();
+
+    private:
+        static const int64_t capacity = 4096;
+        std::atomic<int64_t> top;
+        std::atomic<int64_t> bottom;
+        std::atomic<Job*> jobs[capacity];
+    };
+
+    std::vector<Deque*> deques;
+    std::vector<std::thread> workers;
+    std::atomic<bool> stopping;
+
+    // Idle workers sleep until jobs are queued
+    std::atomic<int> numQueued;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    // Deque of the calling thread or -1 if it is not one of the system's threads
+    int threadIndex();
+
+    Job *findJob(const int index);
+    void execute(Job *job);
+    void workerLoop(const int index);
+};
@@ -1,4 +1,8 @@
 
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
 #include <common/light.hpp>
 
 void Light::addPointLight(const glm::vec3 position, const glm::vec3 colour,
@@ -41,25 +45,48 @@ void Light::addDirectionalLight(const glm::vec3 direction, const glm::vec3 colou
     lightSources.push_back(light);
 }
 
-void Light::toShader(unsigned int shaderID, glm::mat4 view)
+float Light::influenceRadius(const LightSource &light, const float threshold)
+{
+    if (light.type == 3)
+        return std::numeric_limits<float>::infinity();
+
+    // Solve quadratic * d^2 + linear * d + constant = intensity / threshold for d
+    float intensity = std::max(light.colour.x, std::max(light.colour.y, light.colour.z));
+    float c = light.constant - intensity / threshold;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.quadratic <= 0.0f)
+        return light.linear > 0.0f ? -c / light.linear : std::numeric_limits<float>::infinity();
+    return (-light.linear + sqrtf(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+}
+
+LightUniforms Light::toUniforms(const LightSource &light, const glm::mat4 &view)
 {
-    unsigned int numLights = static_cast<unsigned int>(lightSources.size());
-    glUniform1i(glGetUniformLocation(shaderID, "numLights"), numLights);
+    LightUniforms uniforms = {};
+    uniforms.position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+    uniforms.direction = glm::vec3(view * glm::vec4(light.direction, 0.0f));
+    uniforms.colour = light.colour;
+    uniforms.constant = light.constant;
+    uniforms.linear = light.linear;
+    uniforms.quadratic = light.quadratic;
+    uniforms.cosPhi = light.cosPhi;
+    uniforms.type = light.type;
+    uniforms.shadowTile = light.shadowTile;
+    return uniforms;
+}
 
+void Light::toShader(StreamBuffer &streamBuffer, glm::mat4 view)
+{
+    // Unused slots keep type 0 so the shaders skip them
+    LightUniforms block[maxLights] = {};
+
+    unsigned int numLights = std::min(static_cast<unsigned int>(lightSources.size()), maxLights);
     for (unsigned int i = 0; i < numLights; i++)
-    {
-        std::string idx = std::to_string(i);
-        glm::vec3 VSLightPosition = glm::vec3(view * glm::vec4(lightSources[i].position, 1.0f));
-        glm::vec3 VSLightDirection = glm::vec3(view * glm::vec4(lightSources[i].direction, 0.0f));
-        glUniform3fv(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].position").c_str()), 1, &VSLightPosition[0]);
-        glUniform3fv(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].direction").c_str()), 1, &VSLightDirection[0]);
-        glUniform3fv(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].colour").c_str()), 1, &lightSources[i].colour[0]);
-        glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].constant").c_str()), lightSources[i].constant);
-        glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].linear").c_str()), lightSources[i].linear);
-        glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].quadratic").c_str()), lightSources[i].quadratic);
-        glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].cosPhi").c_str()), lightSources[i].cosPhi);
-        glUniform1i(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].type").c_str()), lightSources[i].type);
-    }
+        block[i] = toUniforms(lightSources[i], view);
+
+    size_t offset;
+    if (streamBuffer.write(block, sizeof(block), streamBuffer.uniformAlignment, offset))
+        glBindBufferRange(GL_UNIFORM_BUFFER, lightBlockBinding, streamBuffer.buffer, offset, sizeof(block));
 }
 
 void Light::draw(unsigned int shaderID, glm::mat4 view, glm::mat4 projection, Model lightModel)
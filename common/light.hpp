@@ -3,6 +3,10 @@
 
 #include <external/glm-0.9.7.1/glm/gtc/matrix_transform.hpp>
 #include <common/model.hpp>
+#include <common/streambuffer.hpp>
+
+// Must match maxLights in the shaders
+const unsigned int maxLights = 10;
 
 struct LightSource
 {
@@ -14,6 +18,26 @@ struct LightSource
     float quadratic;
     float cosPhi;
     unsigned int type;
+
+    // Shadow casting lights get atlas tiles, shadowTile is the first of them
+    // once they all hold a depth map and -1 otherwise
+    bool castShadows = false;
+    int shadowTile = -1;
+};
+
+// View space light as laid out in the shaders' LightBlock (std140)
+struct LightUniforms
+{
+    glm::vec3 position;
+    float constant;
+    glm::vec3 colour;
+    float linear;
+    glm::vec3 direction;
+    float quadratic;
+    float cosPhi;
+    int type;
+    int shadowTile;
+    float padding;
 };
 
 class Light
@@ -32,8 +56,15 @@ public:
         const float cosPhi);
     void addDirectionalLight(const glm::vec3 direction, const glm::vec3 colour);
 
-    // Send to shader
-    void toShader(unsigned int shaderID, glm::mat4 view);
+    // Distance at which a point or spot light's attenuated intensity falls
+    // below the threshold, infinite for directional lights
+    static float influenceRadius(const LightSource &light, const float threshold = 1.0f / 256.0f);
+
+    // View space uniforms of a light
+    static LightUniforms toUniforms(const LightSource &light, const glm::mat4 &view);
+
+    // Write the view space lights to the stream buffer and bind them to LightBlock
+    void toShader(StreamBuffer &streamBuffer, glm::mat4 view);
 
     // Draw light source
     void draw(unsigned int shaderID, glm::mat4 view, glm::mat4 projection, Model lightModel);
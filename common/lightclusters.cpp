@@ -0,0 +1,173 @@
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#include <common/lightclusters.hpp>
+#include <common/jobsystem.hpp>
+
+LightClusters::LightClusters(const int tilesX, const int tilesY, const int slices)
+{
+    this->tilesX = tilesX;
+    this->tilesY = tilesY;
+    this->slices = slices;
+    sliceLists.resize(slices);
+    sliceOffsets.resize(slices + 1);
+}
+
+int LightClusters::slice(const float depth, const float near, const float far)
+{
+    int s = static_cast<int>(floorf(logf(depth / near) * slices / logf(far / near)));
+    return std::min(std::max(s, 0), slices - 1);
+}
+
+void LightClusters::build(const std::vector<LightSource> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                          const float near, const float far)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Pack the lights in view space, global lights first
+    lightData.clear();
+    localLights.clear();
+    numGlobalLights = 0;
+    for (int pass = 0; pass < 2; pass++)
+        for (unsigned int i = 0; i < lights.size(); i++)
+        {
+            const LightSource &light = lights[i];
+            float radius = Light::influenceRadius(light);
+            bool global = !std::isfinite(radius);
+            if (global != (pass == 0) || radius <= 0.0f)
+                continue;
+
+            glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            glm::vec3 direction = glm::vec3(view * glm::vec4(light.direction, 0.0f));
+            unsigned int index = static_cast<unsigned int>(lightData.size() / texelsPerLight);
+            lightData.push_back(glm::vec4(position, light.constant));
+            lightData.push_back(glm::vec4(light.colour, light.linear));
+            lightData.push_back(glm::vec4(direction, light.quadratic));
+            lightData.push_back(glm::vec4(light.cosPhi, static_cast<float>(light.type), 0.0f, 0.0f));
+            if (global)
+            {
+                numGlobalLights++;
+                continue;
+            }
+
+            // Lights entirely in front of the near plane or beyond the far plane light nothing
+            LocalLight local;
+            local.centre = position;
+            local.radius = radius;
+            local.minDepth = std::max(-position.z - radius, near);
+            local.maxDepth = std::min(-position.z + radius, far);
+            local.index = index;
+            if (local.minDepth <= local.maxDepth)
+                localLights.push_back(local);
+        }
+    numLocalLights = static_cast<unsigned int>(localLights.size());
+
+    // Bin the lights one slice per job
+    if (jobs)
+        jobs->parallelFor(0, slices, [&](unsigned int first, unsigned int last)
+        {
+            for (unsigned int s = first; s < last; s++)
+                buildSlice(s, projection, near, far);
+        }, 1);
+    else
+        for (int s = 0; s < slices; s++)
+            buildSlice(s, projection, near, far);
+
+    // Concatenate the slices, offsetting each slice's ranges by its position
+    unsigned int clustersPerSlice = tilesX * tilesY;
+    sliceOffsets[0] = 0;
+    for (int s = 0; s < slices; s++)
+        sliceOffsets[s + 1] = sliceOffsets[s] + static_cast<unsigned int>(sliceLists[s].indices.size());
+    clusterRanges.resize(2 * clustersPerSlice * slices);
+    lightIndices.resize(sliceOffsets[slices]);
+    maxLightsPerCluster = 0;
+    for (int s = 0; s < slices; s++)
+    {
+        const SliceList &list = sliceLists[s];
+        unsigned int *ranges = &clusterRanges[2 * clustersPerSlice * s];
+        for (unsigned int c = 0; c < clustersPerSlice; c++)
+        {
+            ranges[2 * c] = list.ranges[2 * c] + sliceOffsets[s];
+            ranges[2 * c + 1] = list.ranges[2 * c + 1];
+            maxLightsPerCluster = std::max(maxLightsPerCluster, list.ranges[2 * c + 1]);
+        }
+        std::copy(list.indices.begin(), list.indices.end(), lightIndices.begin() + sliceOffsets[s]);
+    }
+
+    buildMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::buildSlice(const int s, const glm::mat4 &projection, const float near, const float far)
+{
+    SliceList &list = sliceLists[s];
+    unsigned int clustersPerSlice = tilesX * tilesY;
+    list.ranges.assign(2 * clustersPerSlice, 0);
+    list.rects.clear();
+    list.overlapping.clear();
+
+    // Depth range of the slice
+    float sliceNear = near * powf(far / near, static_cast<float>(s) / slices);
+    float sliceFar = near * powf(far / near, static_cast<float>(s + 1) / slices);
+
+    // Screen tiles covered by the part of each light's bounding box inside the slice,
+    // the box is projected at both ends of its depth range
+    for (unsigned int l = 0; l < localLights.size(); l++)
+    {
+        const LocalLight &light = localLights[l];
+        float depth0 = std::max(light.minDepth, sliceNear);
+        float depth1 = std::min(light.maxDepth, sliceFar);
+        if (depth0 > depth1)
+            continue;
+
+        float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f;
+        float depths[2] = { depth0, depth1 };
+        for (int d = 0; d < 2; d++)
+            for (int corner = 0; corner < 4; corner++)
+            {
+                float x = light.centre.x + ((corner & 1) ? light.radius : -light.radius);
+                float y = light.centre.y + ((corner & 2) ? light.radius : -light.radius);
+                float ndcX = projection[0][0] * x / depths[d];
+                float ndcY = projection[1][1] * y / depths[d];
+                minX = std::min(minX, ndcX);
+                maxX = std::max(maxX, ndcX);
+                minY = std::min(minY, ndcY);
+                maxY = std::max(maxY, ndcY);
+            }
+        if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+            continue;
+
+        int x0 = std::max(0, static_cast<int>((0.5f * minX + 0.5f) * tilesX));
+        int x1 = std::min(tilesX - 1, static_cast<int>((0.5f * maxX + 0.5f) * tilesX));
+        int y0 = std::max(0, static_cast<int>((0.5f * minY + 0.5f) * tilesY));
+        int y1 = std::min(tilesY - 1, static_cast<int>((0.5f * maxY + 0.5f) * tilesY));
+        list.overlapping.push_back(light.index);
+        list.rects.push_back(x0);
+        list.rects.push_back(x1);
+        list.rects.push_back(y0);
+        list.rects.push_back(y1);
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+                list.ranges[2 * (y * tilesX + x) + 1]++;
+    }
+
+    // Counts to offsets, then scatter the light indices into each cluster's range
+    unsigned int offset = 0;
+    for (unsigned int c = 0; c < clustersPerSlice; c++)
+    {
+        list.ranges[2 * c] = offset;
+        offset += list.ranges[2 * c + 1];
+        list.ranges[2 * c + 1] = 0;
+    }
+    list.indices.resize(offset);
+    for (unsigned int o = 0; o < list.overlapping.size(); o++)
+    {
+        const int *rect = &list.rects[4 * o];
+        for (int y = rect[2]; y <= rect[3]; y++)
+            for (int x = rect[0]; x <= rect[1]; x++)
+            {
+                unsigned int *range = &list.ranges[2 * (y * tilesX + x)];
+                list.indices[range[0] + range[1]++] = list.overlapping[o];
+            }
+    }
+}
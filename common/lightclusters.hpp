@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <common/light.hpp>
+
+class JobSystem;
+
+// Lights binned into a froxel grid, tiles across the screen times
+// exponentially spaced depth slices. Each slice is built by its own job,
+// which tests every light's view space bounds against the slice and writes
+// the slice's clusters into a local index list. The slice lists are then
+// concatenated, so a fragment only loops over the lights of its cluster.
+// Directional and unbounded lights are global and lit everywhere.
+class LightClusters
+{
+public:
+    // Grid size
+    int tilesX, tilesY, slices;
+
+    // View space lights, texelsPerLight RGBA texels each, the global lights first:
+    //   position, constant | colour, linear | direction, quadratic | cosPhi, type, 0, 0
+    static const unsigned int texelsPerLight = 4;
+    std::vector<glm::vec4> lightData;
+    unsigned int numGlobalLights = 0;
+
+    // First index and count of each cluster's lights, the indices point into lightData
+    std::vector<unsigned int> clusterRanges;
+    std::vector<unsigned int> lightIndices;
+
+    // Statistics for the last build
+    unsigned int numLocalLights = 0;
+    unsigned int maxLightsPerCluster = 0;
+    float buildMilliseconds = 0.0f;
+
+    // Slices are built as jobs when set
+    JobSystem *jobs = NULL;
+
+    // Constructor, the default is 64 pixel tiles at 1024x768
+    LightClusters(const int tilesX = 16, const int tilesY = 12, const int slices = 24);
+
+    // Assign the world space lights to the clusters of a perspective camera
+    void build(const std::vector<LightSource> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+               const float near, const float far);
+
+    // Depth slice containing a positive view depth
+    int slice(const float depth, const float near, const float far);
+
+private:
+    // View space sphere and depth range of a local light
+    struct LocalLight
+    {
+        glm::vec3 centre;
+        float radius;
+        float minDepth, maxDepth;
+        unsigned int index;
+    };
+    std::vector<LocalLight> localLights;
+
+    // Output of one slice, ranges are relative to the slice's own indices
+    struct SliceList
+    {
+        std::vector<unsigned int> ranges;
+        std::vector<unsigned int> indices;
+        std::vector<int> rects;
+        std::vector<unsigned int> overlapping;
+    };
+    std::vector<SliceList> sliceLists;
+    std::vector<unsigned int> sliceOffsets;
+
+    void buildSlice(const int s, const glm::mat4 &projection, const float near, const float far);
+};
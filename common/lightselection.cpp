@@ -0,0 +1,116 @@
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#include <common/lightselection.hpp>
+#include <common/jobsystem.hpp>
+
+// Spot lights fade out over this angle beyond cosPhi, as in the shaders
+static const float spotFadeRadians = glm::radians(2.0f);
+
+void LightSelection::build(const std::vector<LightSource> &lights, BoundsArray &bounds,
+                           const std::vector<unsigned int> &objects)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    globalLights.clear();
+    volumes.clear();
+    for (unsigned int i = 0; i < static_cast<unsigned int>(lights.size()); i++)
+    {
+        const LightSource &light = lights[i];
+        float radius = Light::influenceRadius(light);
+        if (std::isinf(radius))
+        {
+            globalLights.push_back(i);
+            continue;
+        }
+        if (radius <= 0.0f)
+            continue;
+
+        Volume volume;
+        volume.position = light.position;
+        volume.radius = radius;
+        volume.spot = light.type == 2;
+        volume.direction = volume.spot ? glm::normalize(light.direction) : glm::vec3(0.0f);
+        float angle = std::min(acosf(std::min(std::max(light.cosPhi, -1.0f), 1.0f)) + spotFadeRadians, glm::pi<float>());
+        volume.cosAngle = cosf(angle);
+        volume.sinAngle = sinf(angle);
+        volume.intensity = std::max(light.colour.x, std::max(light.colour.y, light.colour.z));
+        volume.constant = light.constant;
+        volume.linear = light.linear;
+        volume.quadratic = light.quadratic;
+        volume.index = i;
+        volumes.push_back(volume);
+    }
+    numLocalLights = static_cast<unsigned int>(volumes.size());
+
+    unsigned int n = static_cast<unsigned int>(objects.size());
+    indices.resize(n * maxLights);
+    counts.resize(n);
+    auto selectRange = [&](const unsigned int first, const unsigned int last)
+    {
+        for (unsigned int k = first; k < last; k++)
+            counts[k] = select(bounds.box(objects[k]), &indices[k * maxLights]);
+    };
+    if (jobs)
+        jobs->parallelFor(0, n, selectRange, 256);
+    else
+        selectRange(0, n);
+
+    unsigned int total = 0;
+    for (unsigned int k = 0; k < n; k++)
+        total += counts[k];
+    averageLights = n > 0 ? static_cast<float>(total) / n : 0.0f;
+
+    buildMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+unsigned int LightSelection::select(const AABB &box, unsigned int *selected) const
+{
+    unsigned int count = std::min(static_cast<unsigned int>(globalLights.size()), maxLights);
+    std::copy(globalLights.begin(), globalLights.begin() + count, selected);
+
+    // Keep the local lights sorted by decreasing intensity in the remaining slots
+    float scores[maxLights];
+    unsigned int numLocal = 0;
+    unsigned int capacity = maxLights - count;
+    glm::vec3 centre = 0.5f * (box.min + box.max);
+    float boxRadius = glm::length(0.5f * (box.max - box.min));
+    for (const Volume &volume : volumes)
+    {
+        // Sphere against box
+        glm::vec3 closest = glm::clamp(volume.position, box.min, box.max);
+        glm::vec3 offset = closest - volume.position;
+        float distance2 = glm::dot(offset, offset);
+        if (distance2 > volume.radius * volume.radius)
+            continue;
+
+        // Cone against the box's bounding sphere, rejecting boxes behind the
+        // apex or farther than boxRadius from the cone's surface
+        if (volume.spot)
+        {
+            glm::vec3 v = centre - volume.position;
+            float along = glm::dot(v, volume.direction);
+            float across = sqrtf(std::max(glm::dot(v, v) - along * along, 0.0f));
+            if (along < -boxRadius || volume.cosAngle * across - volume.sinAngle * along > boxRadius)
+                continue;
+        }
+
+        float distance = sqrtf(distance2);
+        float score = volume.intensity / (volume.constant + volume.linear * distance + volume.quadratic * distance2);
+        if (numLocal == capacity && (capacity == 0 || score <= scores[numLocal - 1]))
+            continue;
+
+        unsigned int slot = std::min(numLocal, capacity - 1);
+        while (slot > 0 && scores[slot - 1] < score)
+        {
+            scores[slot] = scores[slot - 1];
+            selected[count + slot] = selected[count + slot - 1];
+            slot--;
+        }
+        scores[slot] = score;
+        selected[count + slot] = volume.index;
+        numLocal = std::min(numLocal + 1, capacity);
+    }
+    return count + numLocal;
+}
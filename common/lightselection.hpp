@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <common/light.hpp>
+#include <common/culling.hpp>
+
+class JobSystem;
+
+// Chooses the lights that reach each object so that a forward draw only
+// loops over those. Point lights are bounded by their influence radius and
+// spot lights by that sphere cut to their cone. Every object keeps the
+// global (directional or unbounded) lights and then the local lights with
+// the highest estimated intensity at its box, at most maxLights in total.
+class LightSelection
+{
+public:
+    // maxLights light indices per object, counts[k] of them used
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> counts;
+
+    // Statistics for the last build
+    unsigned int numLocalLights = 0;
+    float averageLights = 0.0f;
+    float buildMilliseconds = 0.0f;
+
+    // Objects are selected for as jobs when set
+    JobSystem *jobs = NULL;
+
+    // Select the lights of the objects' boxes in bounds
+    void build(const std::vector<LightSource> &lights, BoundsArray &bounds,
+               const std::vector<unsigned int> &objects);
+
+    // Write the indices of the lights reaching a box, returns their number
+    unsigned int select(const AABB &box, unsigned int *selected) const;
+
+private:
+    // World space bounds of a local light
+    struct Volume
+    {
+        glm::vec3 position;
+        float radius;
+        glm::vec3 direction;
+        float cosAngle, sinAngle;
+        float intensity;
+        float constant, linear, quadratic;
+        unsigned int index;
+        bool spot;
+    };
+
+    std::vector<unsigned int> globalLights;
+    std::vector<Volume> volumes;
+};
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include <common/materials.hpp>
+#include <common/streambuffer.hpp>
+#include <common/stb_image.hpp>
+
+MaterialTable::MaterialTable()
+{
+}
+
+int MaterialTable::addLayer(const char *path)
+{
+    int imageWidth, imageHeight, nChannels;
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char *data = stbi_load(path, &imageWidth, &imageHeight, &nChannels, 4);
+    if (!data)
+    {
+        printf("Texture %s failed to load.\n", path);
+        return -1;
+    }
+    if (numLayers > 0 && (imageWidth != width || imageHeight != height))
+    {
+        printf("Materials: %s is %dx%d, the layers are %dx%d\n", path, imageWidth, imageHeight, width, height);
+        stbi_image_free(data);
+        return -1;
+    }
+
+    width = imageWidth;
+    height = imageHeight;
+    pixels.insert(pixels.end(), data, data + width * height * 4);
+    stbi_image_free(data);
+    return numLayers++;
+}
+
+int MaterialTable::addSolidLayer(const unsigned char r, const unsigned char g, const unsigned char b)
+{
+    for (int i = 0; i < width * height; i++)
+    {
+        pixels.push_back(r);
+        pixels.push_back(g);
+        pixels.push_back(b);
+        pixels.push_back(255);
+    }
+    return numLayers++;
+}
+
+int MaterialTable::addMaterial(const int diffuseLayer, const int normalLayer, const int specularLayer,
+                               const float ka, const float kd, const float ks, const float Ns,
+                               const glm::vec3 tint)
+{
+    if (materials.size() >= maxMaterials)
+        return -1;
+
+    // Defaults are created on first use, once the layer size is known
+    if (width == 0)
+        width = height = 1;
+    if (normalLayer < 0 && flatNormalLayer < 0)
+        flatNormalLayer = addSolidLayer(128, 128, 255);
+    if ((diffuseLayer < 0 || specularLayer < 0) && whiteLayer < 0)
+        whiteLayer = addSolidLayer(255, 255, 255);
+
+    MaterialUniforms material = {};
+    material.tint = glm::vec4(tint, 1.0f);
+    material.ka = ka;
+    material.kd = kd;
+    material.ks = ks;
+    material.Ns = Ns;
+    material.diffuseLayer = diffuseLayer >= 0 ? diffuseLayer : whiteLayer;
+    material.normalLayer = normalLayer >= 0 ? normalLayer : flatNormalLayer;
+    material.specularLayer = specularLayer >= 0 ? specularLayer : whiteLayer;
+    materials.push_back(material);
+    return static_cast<int>(materials.size()) - 1;
+}
+
+void MaterialTable::build()
+{
+    if (numLayers > 0)
+    {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, numLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+    pixels.clear();
+    pixels.shrink_to_fit();
+
+    // Unused rows stay zero, the block is always bound at its full size
+    std::vector<MaterialUniforms> table(maxMaterials, MaterialUniforms());
+    std::copy(materials.begin(), materials.end(), table.begin());
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, table.size() * sizeof(MaterialUniforms), &table[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    printf("Materials: %u materials, %u layers of %dx%d\n", static_cast<unsigned int>(materials.size()), numLayers, width, height);
+}
+
+void MaterialTable::bind(unsigned int shaderID)
+{
+    glBindBufferBase(GL_UNIFORM_BUFFER, materialBlockBinding, buffer);
+    glUseProgram(shaderID);
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(shaderID, "materialLayers"), unit);
+    glUniform1i(glGetUniformLocation(shaderID, "useMaterialTable"), texture != 0);
+}
+
+void MaterialTable::deleteBuffers()
+{
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &buffer);
+}
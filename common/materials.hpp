@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Must match maxMaterials in the shaders, the table fits in the smallest uniform block size
+const unsigned int maxMaterials = 256;
+
+// Vertex attribute of the material index, after the instance matrix at 5 to 8
+const unsigned int materialAttribute = 9;
+
+// Material as laid out in the shaders' MaterialBlock (std140)
+struct MaterialUniforms
+{
+    glm::vec4 tint;
+    float ka, kd, ks, Ns;
+    int diffuseLayer, normalLayer, specularLayer;
+    float padding;
+};
+
+// Every material's textures are layers of one texture array and their
+// parameters rows of one uniform block, so draws only pass a material index
+// per instance or vertex and objects with different materials share a draw.
+// All layers have the size of the first image added.
+class MaterialTable
+{
+public:
+    std::vector<MaterialUniforms> materials;
+
+    // Layer size and count
+    int width = 0, height = 0;
+    unsigned int numLayers = 0;
+
+    // Constructor
+    MaterialTable();
+
+    // Load an image into a new layer, returns the layer or -1 if it fails to load or has another size
+    int addLayer(const char *path);
+
+    // Add a material after its layers, missing layers use flat defaults.
+    // Returns the material index or -1 when the table is full.
+    int addMaterial(const int diffuseLayer, const int normalLayer, const int specularLayer,
+                    const float ka, const float kd, const float ks, const float Ns,
+                    const glm::vec3 tint = glm::vec3(1.0f));
+
+    // Upload the layers and the table
+    void build();
+
+    // Bind the texture array and the table to a program
+    void bind(unsigned int shaderID);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    // Texture unit above the shadow atlases
+    static const unsigned int unit = 13;
+
+    // Default layers, white for missing specular maps and a flat normal map
+    int whiteLayer = -1, flatNormalLayer = -1;
+
+    // RGBA8 layers waiting for build
+    std::vector<unsigned char> pixels;
+
+    unsigned int texture = 0;
+    unsigned int buffer = 0;
+
+    // Append a layer of one colour
+    int addSolidLayer(const unsigned char r, const unsigned char g, const unsigned char b);
+};
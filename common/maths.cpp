@@ -21,12 +21,32 @@ float Maths::radians(float angle) {
 
 glm::mat4 Maths::rotate(const float& angle, glm::vec3 v)
 {
-    v = glm::normalize(v);
+    return axisAngle(angle, v).matrix();
+}
+
+Quaternion Maths::axisAngle(const float angle, glm::vec3 axis)
+{
+    axis = glm::normalize(axis);
     float c = cos(0.5f * angle);
     float s = sin(0.5f * angle);
-    Quaternion q(c, s * v.x, s * v.y, s * v.z);
+    return Quaternion(c, s * axis.x, s * axis.y, s * axis.z);
+}
 
-    return q.matrix();
+glm::mat4 Maths::transform(const glm::vec3 &position, const float angle, const glm::vec3 &axis, const glm::vec3 &scale)
+{
+    return transform(position, axisAngle(angle, axis), scale);
+}
+
+glm::mat4 Maths::transform(const glm::vec3 &position, Quaternion rotation, const glm::vec3 &scale)
+{
+    // Scale the rotation's columns and set the translation instead of multiplying matrices
+    glm::mat4 matrix = rotation.matrix();
+    matrix[0] *= scale.x;
+    matrix[1] *= scale.y;
+    matrix[2] *= scale.z;
+    matrix[3] = glm::vec4(position, 1.0f);
+
+    return matrix;
 }
 
 // Quaternions
@@ -103,4 +123,30 @@ Quaternion Maths::SLERP(Quaternion q1, Quaternion q2, const float t)
     q.z = a * q1.z + b * q2.z;
 
     return q;
-}
\ No newline at end of file
+}
+
+// Bounding box of a transformed box
+AABB Maths::transformAABB(const AABB &box, const glm::mat4 &matrix)
+{
+    // Transform the centre and accumulate the absolute extents along each axis
+    glm::vec3 centre = 0.5f * (box.min + box.max);
+    glm::vec3 extent = 0.5f * (box.max - box.min);
+    glm::vec3 newCentre = glm::vec3(matrix * glm::vec4(centre, 1.0f));
+    glm::vec3 newExtent;
+    for (int i = 0; i < 3; i++)
+        newExtent[i] = fabs(matrix[0][i]) * extent.x + fabs(matrix[1][i]) * extent.y + fabs(matrix[2][i]) * extent.z;
+
+    AABB result;
+    result.min = newCentre - newExtent;
+    result.max = newCentre + newExtent;
+    return result;
+}
+
+// Sphere enclosing a box
+Sphere Maths::boundingSphere(const AABB &box)
+{
+    Sphere sphere;
+    sphere.centre = 0.5f * (box.min + box.max);
+    sphere.radius = 0.5f * glm::length(box.max - box.min);
+    return sphere;
+}
@@ -19,6 +19,20 @@ public:
     Quaternion(const float pitch, const float yaw);
 };
 
+// Axis-aligned bounding box
+struct AABB
+{
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+};
+
+// Bounding sphere
+struct Sphere
+{
+    glm::vec3 centre = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
 // Maths namespace
 namespace Maths
 {
@@ -28,5 +42,16 @@ namespace Maths
     float radians(float angle);
     glm::mat4 rotate(const float& angle, glm::vec3 v);
 
+    // Rotation about an axis as a quaternion
+    Quaternion axisAngle(const float angle, glm::vec3 axis);
+
+    // translate(position) * rotate(angle, axis) * scale(scale) built directly
+    glm::mat4 transform(const glm::vec3 &position, const float angle, const glm::vec3 &axis, const glm::vec3 &scale);
+    glm::mat4 transform(const glm::vec3 &position, Quaternion rotation, const glm::vec3 &scale);
+
     Quaternion SLERP(const Quaternion q1, const Quaternion q2, const float t);
+
+    // Bounding volumes
+    AABB transformAABB(const AABB &box, const glm::mat4 &matrix);
+    Sphere boundingSphere(const AABB &box);
 }
\ No newline at end of file
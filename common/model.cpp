@@ -3,23 +3,96 @@
 #include <string>
 #include <cstring>
 #include <iostream>
+#include <algorithm>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
 #include "model.hpp"
+#include "materials.hpp"
 #include "stb_image.hpp"
 
 Model::Model(const char *path)
 {
     // Load object
     bool res = loadObj(path, vertices, uvs, normals);
+    calculateBounds();
     
     // Setup buffers
     setupBuffers();
 }
 
 void Model::draw(unsigned int &shaderID)
+{
+    bindMaterial(shaderID);
+    drawMesh();
+}
+
+void Model::drawMesh()
+{
+    // Draw the triangles
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<unsigned int>(vertices.size()));
+    glBindVertexArray(0);
+}
+
+void Model::drawInstanced(unsigned int &shaderID, unsigned int instanceBuffer, size_t offset, unsigned int numInstances,
+                          const long long materialOffset)
+{
+    if (numInstances == 0)
+        return;
+    
+    bindMaterial(shaderID);
+    
+    // Point the per-instance matrix attributes at this frame's instance data
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        glEnableVertexAttribArray(5 + i);
+        glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + i * sizeof(glm::vec4)));
+    }
+    if (materialOffset >= 0)
+    {
+        glEnableVertexAttribArray(materialAttribute);
+        glVertexAttribIPointer(materialAttribute, 1, GL_INT, sizeof(int), (void*)materialOffset);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    // Draw every instance with a single call
+    glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<unsigned int>(vertices.size()), numInstances);
+    
+    // Non-instanced draws must not source the instance attributes
+    for (unsigned int i = 0; i < 4; i++)
+        glDisableVertexAttribArray(5 + i);
+    glDisableVertexAttribArray(materialAttribute);
+    glBindVertexArray(0);
+}
+
+void Model::drawIndirect(unsigned int &shaderID, unsigned int instanceBuffer, unsigned int indirectBuffer)
+{
+    bindMaterial(shaderID);
+    
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        glEnableVertexAttribArray(5 + i);
+        glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    // The instance count is only known on the GPU
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glDrawArraysIndirect(GL_TRIANGLES, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    
+    for (unsigned int i = 0; i < 4; i++)
+        glDisableVertexAttribArray(5 + i);
+    glBindVertexArray(0);
+}
+
+void Model::bindMaterial(unsigned int &shaderID)
 {
     // Send material properties to the shader
     glUniform1f(glGetUniformLocation(shaderID, "ka"), ka);
@@ -28,8 +101,6 @@ void Model::draw(unsigned int &shaderID)
     glUniform1f(glGetUniformLocation(shaderID, "Ns"), Ns);
     
     // Bind the textures
-    unsigned int diffuseNum = 0;
-    unsigned int normalNum = 0;
     for (unsigned int i = 0; i < textures.size(); i++)
     {
         // Bind texture
@@ -38,11 +109,6 @@ void Model::draw(unsigned int &shaderID)
         glUniform1i(glGetUniformLocation(shaderID, (name + "Map").c_str()), i);
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
-    
-    // Draw the triangles
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, static_cast<unsigned int>(vertices.size()));
-    glBindVertexArray(0);
 }
 
 void Model::setupBuffers()
@@ -84,10 +150,30 @@ void Model::setupBuffers()
     glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
     glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
     
+    // Per-instance model matrix, a mat4 attribute occupies locations 5 to 8, and
+    // material index. The attributes are enabled and pointed at the instance data by drawInstanced
+    for (unsigned int i = 0; i < 4; i++)
+        glVertexAttribDivisor(5 + i, 1);
+    glVertexAttribDivisor(materialAttribute, 1);
+    
      // Bind the VAO
     glBindVertexArray(0);
 }
 
+void Model::calculateBounds()
+{
+    if (vertices.empty())
+        return;
+    
+    bounds.min = bounds.max = vertices[0];
+    for (unsigned int i = 1; i < vertices.size(); i++)
+    {
+        bounds.min = glm::min(bounds.min, vertices[i]);
+        bounds.max = glm::max(bounds.max, vertices[i]);
+    }
+    boundingSphere = Maths::boundingSphere(bounds);
+}
+
 void Model::deleteBuffers()
 {
     glDeleteBuffers(1, &vertexBuffer);
@@ -7,6 +7,8 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include <common/maths.hpp>
+
 // Texture struct
 struct Texture
 {
@@ -25,11 +27,27 @@ public:
     unsigned int textureID;
     float ka, kd, ks, Ns;
     
+    // Object space bounding volumes
+    AABB bounds;
+    Sphere boundingSphere;
+    
     // Constructor
     Model(const char *path);
     
     // Draw model
     void draw(unsigned int &shaderID);
+    void drawMesh();
+    
+    // Instanced drawing, model matrices are read from instanceBuffer at offset and,
+    // when materialOffset is not negative, material indices at materialOffset
+    void drawInstanced(unsigned int &shaderID, unsigned int instanceBuffer, size_t offset, unsigned int numInstances,
+                       const long long materialOffset = -1);
+    
+    // Instanced drawing with the counts read from a DrawArraysIndirectCommand in indirectBuffer
+    void drawIndirect(unsigned int &shaderID, unsigned int instanceBuffer, unsigned int indirectBuffer);
+    
+    // Bind material properties and textures
+    void bindMaterial(unsigned int &shaderID);
     
     // Add textures
     void addTexture(const char *path, const std::string type);
@@ -54,6 +72,9 @@ private:
     // Setup buffers
     void setupBuffers();
     
+    // Calculate the bounding volumes
+    void calculateBounds();
+    
     // Load texture
     unsigned int loadTexture(const char *path);
 };
@@ -0,0 +1,268 @@
+#include <cmath>
+#include <thread>
+#include <algorithm>
+
+#include <common/occlusion.hpp>
+#include <common/jobsystem.hpp>
+
+#if defined(__AVX2__)
+#define OCCLUSION_AVX2
+#include <immintrin.h>
+#endif
+
+// Corners of a box, bit 0 selects x, bit 1 y and bit 2 z
+static glm::vec3 boxCorner(const AABB &box, const int i)
+{
+    return glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+}
+
+// Two triangles per box face, as corner indices
+static const int boxTriangles[36] = {
+    0, 2, 1, 1, 2, 3,   4, 5, 6, 5, 7, 6,
+    0, 1, 4, 1, 5, 4,   2, 6, 3, 3, 6, 7,
+    0, 4, 2, 2, 4, 6,   1, 3, 5, 3, 7, 5
+};
+
+OcclusionCuller::OcclusionCuller(const int width, const int height, unsigned int numThreads)
+{
+    this->width = width;
+    this->height = height;
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    this->numThreads = std::min(numThreads, static_cast<unsigned int>(height));
+
+    // Allocate the hierarchy once
+    int w = width, h = height;
+    while (true)
+    {
+        levels.push_back(std::vector<float>(w * h, 1.0f));
+        levelWidths.push_back(w);
+        levelHeights.push_back(h);
+        if (w == 1 && h == 1)
+            break;
+        w = std::max(1, (w + 1) / 2);
+        h = std::max(1, (h + 1) / 2);
+    }
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4 &viewProjection)
+{
+    this->viewProjection = viewProjection;
+    triangles.clear();
+    numOccluderTriangles = numTested = numOccluded = 0;
+}
+
+void OcclusionCuller::addOccluder(const AABB &box, const glm::mat4 &modelMatrix)
+{
+    // Project the corners to screen space
+    glm::mat4 MVP = viewProjection * modelMatrix;
+    glm::vec3 screen[8];
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec4 clip = MVP * glm::vec4(boxCorner(box, i), 1.0f);
+
+        // Occluders crossing the near plane are skipped, which is conservative
+        if (clip.w < 1e-3f)
+            return;
+
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        screen[i] = glm::vec3((0.5f * ndc.x + 0.5f) * width, (0.5f * ndc.y + 0.5f) * height, 0.5f * ndc.z + 0.5f);
+    }
+
+    for (int i = 0; i < 36; i++)
+        triangles.push_back(screen[boxTriangles[i]]);
+    numOccluderTriangles += 12;
+}
+
+void OcclusionCuller::rasterize()
+{
+    std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+
+    // Each thread owns a horizontal band so no two threads write the same pixel
+    if (jobs)
+    {
+        jobs->parallelFor(0, height, [this](unsigned int y0, unsigned int y1) { rasterizeBand(y0, y1); },
+                          (height + jobs->size() - 1) / jobs->size());
+        buildHierarchy();
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    int bandHeight = (height + numThreads - 1) / numThreads;
+    for (unsigned int t = 1; t < numThreads; t++)
+    {
+        int y0 = t * bandHeight;
+        int y1 = std::min(height, y0 + bandHeight);
+        if (y0 < y1)
+            threads.push_back(std::thread(&OcclusionCuller::rasterizeBand, this, y0, y1));
+    }
+    rasterizeBand(0, std::min(height, bandHeight));
+    for (unsigned int t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    buildHierarchy();
+}
+
+void OcclusionCuller::rasterizeBand(const int y0, const int y1)
+{
+    float *depth = &levels[0][0];
+    for (unsigned int t = 0; t < triangles.size(); t += 3)
+    {
+        glm::vec3 v0 = triangles[t], v1 = triangles[t + 1], v2 = triangles[t + 2];
+
+        // Make the winding counter-clockwise so the edge functions are positive inside
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (fabs(area) < 1e-6f)
+            continue;
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        // Bounding rectangle clipped to the band
+        int minX = std::max(0, static_cast<int>(floor(std::min(v0.x, std::min(v1.x, v2.x)))));
+        int maxX = std::min(width - 1, static_cast<int>(ceil(std::max(v0.x, std::max(v1.x, v2.x)))));
+        int minY = std::max(y0, static_cast<int>(floor(std::min(v0.y, std::min(v1.y, v2.y)))));
+        int maxY = std::min(y1 - 1, static_cast<int>(ceil(std::max(v0.y, std::max(v1.y, v2.y)))));
+        if (minX > maxX || minY > maxY)
+            continue;
+
+        // Edge functions e(x, y) = a * x + b * y + c
+        float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = v1.x * v2.y - v1.y * v2.x;
+        float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = v2.x * v0.y - v2.y * v0.x;
+        float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = v0.x * v1.y - v0.y * v1.x;
+
+        // Depth is linear in screen space: z = zA * x + zB * y + zC
+        float inverseArea = 1.0f / area;
+        float zA = (a0 * v0.z + a1 * v1.z + a2 * v2.z) * inverseArea;
+        float zB = (b0 * v0.z + b1 * v1.z + b2 * v2.z) * inverseArea;
+        float zC = (c0 * v0.z + c1 * v1.z + c2 * v2.z) * inverseArea;
+
+        for (int y = minY; y <= maxY; y++)
+        {
+            float py = y + 0.5f;
+            float *row = depth + y * width;
+            int x = minX;
+
+#if defined(OCCLUSION_AVX2)
+            // Eight pixels at a time
+            __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            __m256 zero = _mm256_setzero_ps();
+            for (; x + 8 <= maxX + 1; x += 8)
+            {
+                __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), offsets);
+                __m256 e0 = _mm256_fmadd_ps(_mm256_set1_ps(a0), px, _mm256_set1_ps(b0 * py + c0));
+                __m256 e1 = _mm256_fmadd_ps(_mm256_set1_ps(a1), px, _mm256_set1_ps(b1 * py + c1));
+                __m256 e2 = _mm256_fmadd_ps(_mm256_set1_ps(a2), px, _mm256_set1_ps(b2 * py + c2));
+                __m256 inside = _mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ),
+                                              _mm256_and_ps(_mm256_cmp_ps(e1, zero, _CMP_GE_OQ), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ)));
+                if (_mm256_movemask_ps(inside) == 0)
+                    continue;
+
+                __m256 z = _mm256_fmadd_ps(_mm256_set1_ps(zA), px, _mm256_set1_ps(zB * py + zC));
+                __m256 current = _mm256_loadu_ps(row + x);
+                __m256 nearest = _mm256_min_ps(current, z);
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, nearest, inside));
+            }
+#endif
+
+            for (; x <= maxX; x++)
+            {
+                float px = x + 0.5f;
+                if (a0 * px + b0 * py + c0 < 0.0f || a1 * px + b1 * py + c1 < 0.0f || a2 * px + b2 * py + c2 < 0.0f)
+                    continue;
+                float z = zA * px + zB * py + zC;
+                if (z < row[x])
+                    row[x] = z;
+            }
+        }
+    }
+}
+
+void OcclusionCuller::buildHierarchy()
+{
+    // Each texel stores the farthest depth of the 2x2 block below it
+    for (unsigned int level = 1; level < levels.size(); level++)
+    {
+        const std::vector<float> &source = levels[level - 1];
+        std::vector<float> &destination = levels[level];
+        int sourceWidth = levelWidths[level - 1], sourceHeight = levelHeights[level - 1];
+        for (int y = 0; y < levelHeights[level]; y++)
+        {
+            for (int x = 0; x < levelWidths[level]; x++)
+            {
+                int sx0 = 2 * x, sy0 = 2 * y;
+                int sx1 = std::min(sx0 + 1, sourceWidth - 1), sy1 = std::min(sy0 + 1, sourceHeight - 1);
+                float farthest = std::max(std::max(source[sy0 * sourceWidth + sx0], source[sy0 * sourceWidth + sx1]),
+                                          std::max(source[sy1 * sourceWidth + sx0], source[sy1 * sourceWidth + sx1]));
+                destination[y * levelWidths[level] + x] = farthest;
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::isVisible(const AABB &box)
+{
+    numTested++;
+
+    // Screen rectangle and nearest depth of the box
+    // Corners are built from the projected min corner plus the projected box edges
+    glm::vec4 base = viewProjection * glm::vec4(box.min, 1.0f);
+    glm::vec4 edgeX = viewProjection[0] * (box.max.x - box.min.x);
+    glm::vec4 edgeY = viewProjection[1] * (box.max.y - box.min.y);
+    glm::vec4 edgeZ = viewProjection[2] * (box.max.z - box.min.z);
+
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1.0f;
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec4 clip = base;
+        if (i & 1) clip += edgeX;
+        if (i & 2) clip += edgeY;
+        if (i & 4) clip += edgeZ;
+
+        // Boxes crossing the near plane are always visible
+        if (clip.w < 1e-3f)
+            return true;
+
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        float x = (0.5f * ndc.x + 0.5f) * width;
+        float y = (0.5f * ndc.y + 0.5f) * height;
+        minX = std::min(minX, x); maxX = std::max(maxX, x);
+        minY = std::min(minY, y); maxY = std::max(maxY, y);
+        minZ = std::min(minZ, 0.5f * ndc.z + 0.5f);
+    }
+
+    int x0 = std::max(0, static_cast<int>(floor(minX)));
+    int y0 = std::max(0, static_cast<int>(floor(minY)));
+    int x1 = std::min(width - 1, static_cast<int>(floor(maxX)));
+    int y1 = std::min(height - 1, static_cast<int>(floor(maxY)));
+    if (x0 > x1 || y0 > y1)
+        return true;
+
+    // Pick the level where the rectangle covers at most a few texels
+    int extent = std::max(x1 - x0, y1 - y0);
+    unsigned int level = 0;
+    while (extent > 2 && level + 1 < levels.size())
+    {
+        extent >>= 1;
+        level++;
+    }
+    x0 >>= level; x1 >>= level;
+    y0 >>= level; y1 >>= level;
+
+    const std::vector<float> &depth = levels[level];
+    int levelWidth = levelWidths[level];
+    for (int y = y0; y <= y1; y++)
+        for (int x = x0; x <= x1; x++)
+            if (minZ <= depth[y * levelWidth + x])
+                return true;
+
+    numOccluded++;
+    return false;
+}
+
+const std::vector<float> &OcclusionCuller::depthBuffer()
+{
+    return levels[0];
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <common/maths.hpp>
+
+class JobSystem;
+
+// Software occlusion culling. Occluder proxies are rasterized on the CPU into
+// a low resolution depth buffer, split into horizontal bands across threads,
+// a hierarchical max-depth buffer is built from it, and object bounds are
+// tested against that. No GPU readback is involved.
+class OcclusionCuller
+{
+public:
+    // Statistics for the last frame
+    unsigned int numOccluderTriangles = 0;
+    unsigned int numTested = 0;
+    unsigned int numOccluded = 0;
+
+    // Bands are rasterized as jobs when set, otherwise on threads started each frame
+    JobSystem *jobs = NULL;
+
+    // Constructor, numThreads = 0 uses one thread per hardware thread
+    OcclusionCuller(const int width, const int height, unsigned int numThreads = 0);
+
+    // Clear the depth buffer and set the camera
+    void beginFrame(const glm::mat4 &viewProjection);
+
+    // Add a box shaped occluder proxy, the box is in object space
+    void addOccluder(const AABB &box, const glm::mat4 &modelMatrix);
+
+    // Rasterize the occluders and build the depth hierarchy
+    void rasterize();
+
+    // Test a world space box against the depth hierarchy
+    bool isVisible(const AABB &box);
+
+    // Read access to the full resolution depth buffer
+    const std::vector<float> &depthBuffer();
+
+private:
+    int width, height;
+    unsigned int numThreads;
+    glm::mat4 viewProjection;
+
+    // Screen space occluder triangles, three vertices (x, y, depth) each
+    std::vector<glm::vec3> triangles;
+
+    // Depth hierarchy, level 0 is the full resolution buffer
+    std::vector<std::vector<float> > levels;
+    std::vector<int> levelWidths, levelHeights;
+
+    // Rasterize every triangle into rows [y0, y1)
+    void rasterizeBand(const int y0, const int y1);
+
+    void buildHierarchy();
+};
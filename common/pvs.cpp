@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <random>
+#include <thread>
+#include <algorithm>
+
+#include <common/pvs.hpp>
+#include <common/bvh.hpp>
+#include <common/jobsystem.hpp>
+
+// Distance along the ray at which it enters the box, or -1 if it misses
+static float entryDistance(const glm::vec3 &origin, const glm::vec3 &direction, const float maxDistance, const AABB &box)
+{
+    glm::vec3 inverseDirection = 1.0f / direction;
+    glm::vec3 t1 = (box.min - origin) * inverseDirection;
+    glm::vec3 t2 = (box.max - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t1, t2);
+    glm::vec3 tFar = glm::max(t1, t2);
+    float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    return entry <= exit ? entry : -1.0f;
+}
+
+static bool contains(const AABB &box, const glm::vec3 &point)
+{
+    return glm::all(glm::greaterThan(point, box.min)) && glm::all(glm::lessThan(point, box.max));
+}
+
+void PVS::bake(const AABB &region, const float cellSize,
+               const std::vector<AABB> &occluders, const std::vector<AABB> &targets,
+               const unsigned int samplesPerCell, const unsigned int raysPerTarget,
+               unsigned int numThreads)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    this->region = region;
+    this->cellSize = cellSize;
+    dims = glm::max(glm::ivec3(glm::ceil((region.max - region.min) / cellSize)), glm::ivec3(1));
+    numTargets = static_cast<unsigned int>(targets.size());
+    sceneHash = hash(region, cellSize, occluders, targets);
+    numCells = dims.x * dims.y * dims.z;
+
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Cells are handed out one at a time, each thread has its own tree since queries are not thread safe
+    std::vector<std::vector<unsigned char> > cellBits(numCells);
+    std::vector<char> cellSolid(numCells, 0);
+    std::atomic<unsigned int> nextCell(0);
+    auto worker = [&]()
+    {
+        BVH occluderTree;
+        for (unsigned int i = 0; i < occluders.size(); i++)
+            occluderTree.insert(occluders[i], i);
+        occluderTree.rebuild();
+
+        for (unsigned int cell = nextCell++; cell < numCells; cell = nextCell++)
+            cellSolid[cell] = !bakeCell(cell, occluders, targets, occluderTree, samplesPerCell, raysPerTarget, cellBits[cell]);
+    };
+    if (jobs)
+    {
+        JobCounter counter;
+        for (unsigned int t = 0; t < jobs->size(); t++)
+            jobs->run(worker, counter);
+        jobs->wait(counter);
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        for (unsigned int t = 1; t < numThreads; t++)
+            threads.push_back(std::thread(worker));
+        worker();
+        for (unsigned int t = 0; t < threads.size(); t++)
+            threads[t].join();
+    }
+
+    // Compress the sets, cells with identical sets share one copy
+    std::map<std::vector<unsigned char>, int> uniqueSets;
+    std::vector<unsigned char> compressed;
+    cellSets.assign(numCells, -1);
+    setOffsets.assign(1, 0);
+    data.clear();
+    numSolidCells = 0;
+    for (unsigned int cell = 0; cell < numCells; cell++)
+    {
+        if (cellSolid[cell])
+        {
+            numSolidCells++;
+            continue;
+        }
+
+        compress(cellBits[cell], compressed);
+        auto found = uniqueSets.find(compressed);
+        if (found == uniqueSets.end())
+        {
+            found = uniqueSets.insert(std::make_pair(compressed, static_cast<int>(setOffsets.size()) - 1)).first;
+            data.insert(data.end(), compressed.begin(), compressed.end());
+            setOffsets.push_back(static_cast<unsigned int>(data.size()));
+        }
+        cellSets[cell] = found->second;
+    }
+    numSets = static_cast<unsigned int>(setOffsets.size()) - 1;
+    compressedBytes = data.size() + cellSets.size() * sizeof(int) + setOffsets.size() * sizeof(unsigned int);
+    cachedSet = -1;
+
+    bakeMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool PVS::bakeCell(const unsigned int cell, const std::vector<AABB> &occluders, const std::vector<AABB> &targets,
+                   BVH &occluderTree, const unsigned int samplesPerCell, const unsigned int raysPerTarget,
+                   std::vector<unsigned char> &bits)
+{
+    glm::ivec3 coords(cell % dims.x, (cell / dims.x) % dims.y, cell / (dims.x * dims.y));
+    AABB cellBox;
+    cellBox.min = region.min + glm::vec3(coords) * cellSize;
+    cellBox.max = glm::min(cellBox.min + cellSize, region.max);
+    bits.assign((numTargets + 7) / 8, 0);
+
+    // Seeded by the cell so that bakes are repeatable
+    std::mt19937 random(cell);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Any unblocked segment from inside a box to a point outside it also leaves through
+    // its surface, so samples are only taken on the surfaces of the cell and the targets
+    auto surfacePoint = [&](const AABB &box)
+    {
+        glm::vec3 size = box.max - box.min;
+        glm::vec3 point = box.min + glm::vec3(unit(random), unit(random), unit(random)) * size;
+        float areas[3] = { size.y * size.z, size.x * size.z, size.x * size.y };
+        float pick = unit(random) * (areas[0] + areas[1] + areas[2]);
+        int axis = pick < areas[0] ? 0 : (pick < areas[0] + areas[1] ? 1 : 2);
+        point[axis] = unit(random) < 0.5f ? box.min[axis] : box.max[axis];
+        return point;
+    };
+
+    // Targets overlapping the cell are always visible from it
+    for (unsigned int t = 0; t < numTargets; t++)
+        if (glm::all(glm::lessThanEqual(targets[t].min, cellBox.max)) && glm::all(glm::greaterThanEqual(targets[t].max, cellBox.min)))
+            bits[t >> 3] |= 1 << (t & 7);
+
+    bool open = false;
+    for (unsigned int s = 0; s < samplesPerCell; s++)
+    {
+        // Corners first, the camera can not be inside an occluder
+        glm::vec3 sample = s < 8 ? glm::mix(cellBox.min, cellBox.max, glm::vec3(s & 1, (s >> 1) & 1, (s >> 2) & 1))
+                                 : surfacePoint(cellBox);
+        bool solid = false;
+        for (unsigned int i = 0; i < occluders.size() && !solid; i++)
+            solid = contains(occluders[i], sample);
+        if (solid)
+            continue;
+        open = true;
+
+        for (unsigned int t = 0; t < numTargets; t++)
+        {
+            if (bits[t >> 3] & (1 << (t & 7)))
+                continue;
+
+            // Visible if no occluder is hit before the ray enters the target
+            for (unsigned int r = 0; r < raysPerTarget; r++)
+            {
+                glm::vec3 toTarget = surfacePoint(targets[t]) - sample;
+                float distance = glm::length(toTarget);
+                if (distance < 1e-6f)
+                    continue;
+                glm::vec3 direction = toTarget / distance;
+                float entry = entryDistance(sample, direction, distance, targets[t]);
+                float hitDistance;
+                if (entry < 0.0f || occluderTree.raycast(sample, direction, entry, hitDistance) == -1 || hitDistance >= entry - 1e-4f)
+                {
+                    bits[t >> 3] |= 1 << (t & 7);
+                    break;
+                }
+            }
+        }
+    }
+
+    return open;
+}
+
+const std::vector<unsigned int> *PVS::candidates(const glm::vec3 &position)
+{
+    if (cellSets.empty() || glm::any(glm::lessThan(position, region.min)) || glm::any(glm::greaterThanEqual(position, region.max)))
+        return NULL;
+
+    glm::ivec3 coords = glm::min(glm::ivec3((position - region.min) / cellSize), dims - 1);
+    int set = cellSets[coords.x + dims.x * (coords.y + dims.y * coords.z)];
+    if (set == -1)
+        return NULL;
+    if (set == cachedSet)
+        return &cachedCandidates;
+
+    // Expand the zero runs of the compressed set
+    cachedSet = set;
+    cachedCandidates.clear();
+    unsigned int bit = 0;
+    for (unsigned int i = setOffsets[set]; i < setOffsets[set + 1]; i++)
+    {
+        if (data[i] == 0)
+        {
+            bit += 8 * data[++i];
+            continue;
+        }
+        for (unsigned int b = 0; b < 8; b++, bit++)
+            if (data[i] & (1 << b))
+                cachedCandidates.push_back(bit);
+    }
+
+    return &cachedCandidates;
+}
+
+void PVS::compress(const std::vector<unsigned char> &bits, std::vector<unsigned char> &output)
+{
+    // Non-zero bytes are stored as they are, runs of zero bytes as a zero and the run length
+    output.clear();
+    for (unsigned int i = 0; i < bits.size();)
+    {
+        if (bits[i] != 0)
+        {
+            output.push_back(bits[i++]);
+            continue;
+        }
+        unsigned int run = 0;
+        while (i < bits.size() && bits[i] == 0 && run < 255)
+        {
+            run++;
+            i++;
+        }
+        output.push_back(0);
+        output.push_back(static_cast<unsigned char>(run));
+    }
+}
+
+unsigned int PVS::hash(const AABB &region, const float cellSize,
+                       const std::vector<AABB> &occluders, const std::vector<AABB> &targets)
+{
+    // FNV-1a over the inputs, a changed layout invalidates a saved bake
+    unsigned int h = 2166136261u;
+    auto add = [&h](const void *bytes, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            h = (h ^ static_cast<const unsigned char*>(bytes)[i]) * 16777619u;
+    };
+    add(&region, sizeof(AABB));
+    add(&cellSize, sizeof(float));
+    if (!occluders.empty())
+        add(&occluders[0], occluders.size() * sizeof(AABB));
+    if (!targets.empty())
+        add(&targets[0], targets.size() * sizeof(AABB));
+    return h;
+}
+
+bool PVS::save(const char* path)
+{
+    if (cellSets.empty())
+        return false;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        printf("Failed to write PVS file %s\n", path);
+        return false;
+    }
+
+    unsigned int header[6] = { sceneHash, numTargets, static_cast<unsigned int>(cellSets.size()),
+                               static_cast<unsigned int>(setOffsets.size()), static_cast<unsigned int>(data.size()), numSolidCells };
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(&cellSets[0]), cellSets.size() * sizeof(int));
+    file.write(reinterpret_cast<const char*>(&setOffsets[0]), setOffsets.size() * sizeof(unsigned int));
+    if (!data.empty())
+        file.write(reinterpret_cast<const char*>(&data[0]), data.size());
+    return true;
+}
+
+bool PVS::load(const char* path, const AABB &region, const float cellSize,
+               const std::vector<AABB> &occluders, const std::vector<AABB> &targets)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    unsigned int header[6];
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || header[0] != hash(region, cellSize, occluders, targets) || header[1] != targets.size() || header[3] == 0)
+        return false;
+
+    this->region = region;
+    this->cellSize = cellSize;
+    dims = glm::max(glm::ivec3(glm::ceil((region.max - region.min) / cellSize)), glm::ivec3(1));
+    if (header[2] != static_cast<unsigned int>(dims.x * dims.y * dims.z))
+        return false;
+
+    cellSets.resize(header[2]);
+    setOffsets.resize(header[3]);
+    data.resize(header[4]);
+    file.read(reinterpret_cast<char*>(&cellSets[0]), cellSets.size() * sizeof(int));
+    file.read(reinterpret_cast<char*>(&setOffsets[0]), setOffsets.size() * sizeof(unsigned int));
+    if (!data.empty())
+        file.read(reinterpret_cast<char*>(&data[0]), data.size());
+    if (!file)
+    {
+        cellSets.clear();
+        return false;
+    }
+
+    sceneHash = header[0];
+    numTargets = header[1];
+    numCells = header[2];
+    numSets = header[3] - 1;
+    numSolidCells = header[5];
+    compressedBytes = data.size() + cellSets.size() * sizeof(int) + setOffsets.size() * sizeof(unsigned int);
+    bakeMilliseconds = 0.0f;
+    cachedSet = -1;
+    return true;
+}
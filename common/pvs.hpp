@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <common/maths.hpp>
+
+class BVH;
+class JobSystem;
+
+// Potentially visible sets for static scenes. The walkable region is split
+// into cells and for each cell the targets that can be seen from it are found
+// offline by casting rays from sample points in the cell to random points in
+// each target, with the static occluder boxes blocking them. Each cell stores
+// a run-length compressed bitset and identical sets are shared. At runtime the
+// camera's cell gives the candidate list before frustum culling.
+class PVS
+{
+public:
+    // Statistics of the last bake or load
+    unsigned int numCells = 0;
+    unsigned int numSolidCells = 0;
+    unsigned int numSets = 0;
+    size_t compressedBytes = 0;
+    float bakeMilliseconds = 0.0f;
+
+    // Cells are baked as jobs when set, otherwise on numThreads threads
+    JobSystem *jobs = NULL;
+
+    // Bake the sets over region, numThreads = 0 uses one thread per hardware thread
+    void bake(const AABB &region, const float cellSize,
+              const std::vector<AABB> &occluders, const std::vector<AABB> &targets,
+              const unsigned int samplesPerCell = 16, const unsigned int raysPerTarget = 4,
+              unsigned int numThreads = 0);
+
+    // Save a bake, or load one if it was made from the same region and boxes
+    bool save(const char* path);
+    bool load(const char* path, const AABB &region, const float cellSize,
+              const std::vector<AABB> &occluders, const std::vector<AABB> &targets);
+
+    // Targets potentially visible from position, NULL outside the region or
+    // inside solid geometry. The list is cached until the camera changes set.
+    const std::vector<unsigned int> *candidates(const glm::vec3 &position);
+
+private:
+    AABB region;
+    float cellSize = 1.0f;
+    glm::ivec3 dims = glm::ivec3(0);
+    unsigned int numTargets = 0;
+    unsigned int sceneHash = 0;
+
+    // Set index of each cell, -1 for solid cells, and the compressed sets
+    std::vector<int> cellSets;
+    std::vector<unsigned int> setOffsets;
+    std::vector<unsigned char> data;
+
+    // Decompressed set of the camera's cell
+    int cachedSet = -1;
+    std::vector<unsigned int> cachedCandidates;
+
+    // Visibility bitset of one cell, false if every sample was inside an occluder
+    bool bakeCell(const unsigned int cell, const std::vector<AABB> &occluders, const std::vector<AABB> &targets,
+                  BVH &occluderTree, const unsigned int samplesPerCell, const unsigned int raysPerTarget,
+                  std::vector<unsigned char> &bits);
+
+    static unsigned int hash(const AABB &region, const float cellSize,
+                             const std::vector<AABB> &occluders, const std::vector<AABB> &targets);
+    static void compress(const std::vector<unsigned char> &bits, std::vector<unsigned char> &output);
+};
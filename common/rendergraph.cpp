@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <algorithm>
+#include <set>
+
+#include <common/rendergraph.hpp>
+
+// Bytes per sample of each format
+static const unsigned int formatBytes[numTargetFormats] = { 4, 2, 4, 8, 4, 4 };
+
+TargetDesc::TargetDesc(const int width, const int height, const TargetFormat format, const int samples)
+{
+    this->width = width;
+    this->height = height;
+    this->format = format;
+    this->samples = samples;
+}
+
+unsigned int TargetDesc::bytes() const
+{
+    return width * height * std::max(samples, 1) * formatBytes[format];
+}
+
+bool TargetDesc::operator==(const TargetDesc &other) const
+{
+    return width == other.width && height == other.height && format == other.format && samples == other.samples;
+}
+
+void RenderGraph::reset()
+{
+    resources.clear();
+    passes.clear();
+    order.clear();
+}
+
+unsigned int RenderGraph::create(const char *name, const TargetDesc &desc)
+{
+    Resource resource = { name, desc, false, false, 0 };
+    resources.push_back(resource);
+    return static_cast<unsigned int>(resources.size() - 1);
+}
+
+unsigned int RenderGraph::import(const char *name, const unsigned int handle, const bool output)
+{
+    Resource resource = { name, TargetDesc(), true, output, handle };
+    resources.push_back(resource);
+    return static_cast<unsigned int>(resources.size() - 1);
+}
+
+unsigned int RenderGraph::addPass(const char *name, const std::function<void()> &execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    passes.push_back(pass);
+    return static_cast<unsigned int>(passes.size() - 1);
+}
+
+void RenderGraph::read(const unsigned int pass, const unsigned int resource)
+{
+    std::vector<unsigned int> &reads = passes[pass].reads;
+    if (std::find(reads.begin(), reads.end(), resource) == reads.end())
+        reads.push_back(resource);
+}
+
+void RenderGraph::write(const unsigned int pass, const unsigned int resource)
+{
+    // A pass writing both colour and depth of the default framebuffer declares it once
+    std::vector<unsigned int> &writes = passes[pass].writes;
+    if (std::find(writes.begin(), writes.end(), resource) == writes.end())
+        writes.push_back(resource);
+}
+
+bool RenderGraph::compile()
+{
+    unsigned int n = static_cast<unsigned int>(passes.size());
+
+    // Writers of each resource in the order they were added
+    std::vector<std::vector<unsigned int> > writers(resources.size());
+    for (unsigned int p = 0; p < n; p++)
+        for (unsigned int w = 0; w < passes[p].writes.size(); w++)
+            writers[passes[p].writes[w]].push_back(p);
+
+    // Each writer waits for the one before it, a pass that only reads waits for all of them
+    std::vector<std::vector<unsigned int> > dependencies(n);
+    for (unsigned int r = 0; r < resources.size(); r++)
+        for (unsigned int w = 1; w < writers[r].size(); w++)
+            dependencies[writers[r][w]].push_back(writers[r][w - 1]);
+    for (unsigned int p = 0; p < n; p++)
+    {
+        for (unsigned int i = 0; i < passes[p].reads.size(); i++)
+        {
+            unsigned int r = passes[p].reads[i];
+            if (std::find(writers[r].begin(), writers[r].end(), p) == writers[r].end())
+                dependencies[p].insert(dependencies[p].end(), writers[r].begin(), writers[r].end());
+        }
+    }
+
+    // Keep the passes writing outputs and everything they depend on
+    std::vector<bool> alive(n, false);
+    std::vector<unsigned int> stack;
+    for (unsigned int p = 0; p < n; p++)
+    {
+        for (unsigned int w = 0; w < passes[p].writes.size() && !alive[p]; w++)
+        {
+            if (resources[passes[p].writes[w]].output)
+            {
+                alive[p] = true;
+                stack.push_back(p);
+            }
+        }
+    }
+    while (!stack.empty())
+    {
+        unsigned int p = stack.back();
+        stack.pop_back();
+        for (unsigned int d = 0; d < dependencies[p].size(); d++)
+        {
+            if (!alive[dependencies[p][d]])
+            {
+                alive[dependencies[p][d]] = true;
+                stack.push_back(dependencies[p][d]);
+            }
+        }
+    }
+
+    // Topological order of the live passes, the earliest added ready pass goes first
+    std::vector<unsigned int> remaining(n, 0);
+    std::vector<std::vector<unsigned int> > dependents(n);
+    unsigned int numAlive = 0;
+    for (unsigned int p = 0; p < n; p++)
+    {
+        if (!alive[p])
+            continue;
+        numAlive++;
+        remaining[p] = static_cast<unsigned int>(dependencies[p].size());
+        for (unsigned int d = 0; d < dependencies[p].size(); d++)
+            dependents[dependencies[p][d]].push_back(p);
+    }
+    std::set<unsigned int> ready;
+    for (unsigned int p = 0; p < n; p++)
+        if (alive[p] && remaining[p] == 0)
+            ready.insert(p);
+    order.clear();
+    while (!ready.empty())
+    {
+        unsigned int p = *ready.begin();
+        ready.erase(ready.begin());
+        order.push_back(p);
+        for (unsigned int d = 0; d < dependents[p].size(); d++)
+            if (--remaining[dependents[p][d]] == 0)
+                ready.insert(dependents[p][d]);
+    }
+    numPasses = numAlive;
+    numCulled = n - numAlive;
+    if (order.size() != numAlive)
+    {
+        printf("Render graph: dependency cycle, %u of %u passes ordered\n", static_cast<unsigned int>(order.size()), numAlive);
+        return false;
+    }
+
+    // Lifetime of each transient as the first and last position it is used at
+    std::vector<int> first(resources.size(), -1), last(resources.size(), -1);
+    for (unsigned int i = 0; i < order.size(); i++)
+    {
+        const Pass &pass = passes[order[i]];
+        for (unsigned int a = 0; a < pass.reads.size() + pass.writes.size(); a++)
+        {
+            unsigned int r = a < pass.reads.size() ? pass.reads[a] : pass.writes[a - pass.reads.size()];
+            if (first[r] < 0)
+                first[r] = i;
+            last[r] = i;
+        }
+    }
+
+    // Give the transients physical targets in order of first use, taking a free one of the
+    // same description when there is one
+    std::vector<unsigned int> transients;
+    for (unsigned int r = 0; r < resources.size(); r++)
+        if (!resources[r].imported && first[r] >= 0)
+            transients.push_back(r);
+    std::stable_sort(transients.begin(), transients.end(), [&](unsigned int a, unsigned int b) { return first[a] < first[b]; });
+
+    physical.assign(resources.size(), -1);
+    physicalTargets.clear();
+    std::vector<int> physicalLast;
+    numTransients = static_cast<unsigned int>(transients.size());
+    transientBytes = 0;
+    aliasedBytes = 0;
+    for (unsigned int t = 0; t < transients.size(); t++)
+    {
+        unsigned int r = transients[t];
+        transientBytes += resources[r].desc.bytes();
+        for (unsigned int p = 0; p < physicalTargets.size() && physical[r] < 0; p++)
+            if (physicalTargets[p] == resources[r].desc && physicalLast[p] < first[r])
+                physical[r] = p;
+        if (physical[r] < 0)
+        {
+            physical[r] = static_cast<int>(physicalTargets.size());
+            physicalTargets.push_back(resources[r].desc);
+            physicalLast.push_back(-1);
+            aliasedBytes += resources[r].desc.bytes();
+        }
+        physicalLast[physical[r]] = last[r];
+    }
+
+    return true;
+}
+
+void RenderGraph::execute() const
+{
+    for (unsigned int i = 0; i < order.size(); i++)
+        passes[order[i]].execute();
+}
+
+bool RenderGraph::imported(const unsigned int resource) const
+{
+    return resources[resource].imported;
+}
+
+unsigned int RenderGraph::handle(const unsigned int resource) const
+{
+    return resources[resource].handle;
+}
+
+const TargetDesc &RenderGraph::desc(const unsigned int resource) const
+{
+    return resources[resource].desc;
+}
+
+const char *RenderGraph::passName(const unsigned int pass) const
+{
+    return passes[pass].name;
+}
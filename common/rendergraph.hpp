@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+// Formats of the transient render targets
+enum TargetFormat
+{
+    TargetRGBA8 = 0,
+    TargetRG8 = 1,
+    TargetRG16F = 2,
+    TargetRGBA16F = 3,
+    TargetDepth24 = 4,
+    TargetDepth24Stencil8 = 5,
+    numTargetFormats = 6
+};
+
+// Size and format of a render target, targets alias only when these match
+struct TargetDesc
+{
+    int width = 0;
+    int height = 0;
+    TargetFormat format = TargetRGBA8;
+    int samples = 0;
+
+    TargetDesc() {}
+    TargetDesc(const int width, const int height, const TargetFormat format, const int samples = 0);
+
+    unsigned int bytes() const;
+    bool operator==(const TargetDesc &other) const;
+};
+
+// Frame graph. Each frame the passes are added with the resources they read
+// and write, then compiled and executed. Resources are either transient
+// targets described by the graph, which only exist for the frame, or
+// imported objects such as the default framebuffer and history buffers.
+//
+// Compiling
+//   orders  a resource's writers run in the order they were added and
+//           before any pass that only reads it, the passes are sorted
+//           topologically keeping the order they were added where free
+//   culls   passes that nothing marked as an output depends on
+//   aliases each transient gets a physical target, reusing one with the same
+//           description whose last use is over, so targets with disjoint
+//           lifetimes share memory
+// The GL objects of the physical targets come from a RenderTargetPool.
+class RenderGraph
+{
+public:
+    // Passes in execution order and the physical target of each resource, -1 for imported or unused ones
+    std::vector<unsigned int> order;
+    std::vector<TargetDesc> physicalTargets;
+    std::vector<int> physical;
+
+    // Statistics of the last compile, the transient memory with every target on its own and aliased
+    unsigned int numPasses = 0;
+    unsigned int numCulled = 0;
+    unsigned int numTransients = 0;
+    unsigned int transientBytes = 0;
+    unsigned int aliasedBytes = 0;
+
+    // Start a new frame
+    void reset();
+
+    // Add a transient target
+    unsigned int create(const char *name, const TargetDesc &desc);
+
+    // Add an external object, the handle is returned in its place. Passes writing an
+    // output are never culled.
+    unsigned int import(const char *name, const unsigned int handle, const bool output);
+
+    // Add a pass and declare its accesses
+    unsigned int addPass(const char *name, const std::function<void()> &execute);
+    void read(const unsigned int pass, const unsigned int resource);
+    void write(const unsigned int pass, const unsigned int resource);
+
+    // Cull, order and alias, false if the dependencies have a cycle
+    bool compile();
+
+    // Run the surviving passes
+    void execute() const;
+
+    // Resource details for the pool
+    bool imported(const unsigned int resource) const;
+    unsigned int handle(const unsigned int resource) const;
+    const TargetDesc &desc(const unsigned int resource) const;
+    const char *passName(const unsigned int pass) const;
+
+private:
+    struct Resource
+    {
+        const char *name;
+        TargetDesc desc;
+        bool imported;
+        bool output;
+        unsigned int handle;
+    };
+
+    struct Pass
+    {
+        const char *name;
+        std::function<void()> execute;
+        std::vector<unsigned int> reads;
+        std::vector<unsigned int> writes;
+    };
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+};
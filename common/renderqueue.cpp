@@ -0,0 +1,191 @@
+#include <algorithm>
+
+#include <common/renderqueue.hpp>
+#include <common/jobsystem.hpp>
+
+// Field widths
+static const unsigned int shaderBits = 6;
+static const unsigned int materialBits = 12;
+static const unsigned int meshBits = 12;
+static const unsigned int depthBits = 24;
+static const unsigned int stateBits = shaderBits + materialBits + meshBits;
+
+// Queues smaller than this are sorted on one thread
+static const unsigned int parallelSortSize = 65536;
+
+static uint64_t stateField(const unsigned int shader, const unsigned int material, const unsigned int mesh)
+{
+    uint64_t state = shader & ((1u << shaderBits) - 1);
+    state = (state << materialBits) | (material & ((1u << materialBits) - 1));
+    state = (state << meshBits) | (mesh & ((1u << meshBits) - 1));
+    return state;
+}
+
+uint64_t RenderQueue::makeKey(const RenderPass pass, const unsigned int shader, const unsigned int material,
+                              const unsigned int mesh, const float depth)
+{
+    // Quantise the depth
+    const uint64_t maxDepth = (1u << depthBits) - 1;
+    uint64_t quantisedDepth = static_cast<uint64_t>(std::min(std::max(depth, 0.0f), 1.0f) * maxDepth);
+    uint64_t state = stateField(shader, material, mesh);
+
+    if (pass == PassOpaque)
+        return (uint64_t(pass) << 62) | (state << (depthBits + 8)) | (quantisedDepth << 8);
+    return (uint64_t(pass) << 62) | ((maxDepth - quantisedDepth) << (stateBits + 8)) | (state << 8);
+}
+
+void RenderQueue::add(const RenderPass pass, const unsigned int shader, const unsigned int material,
+                      const unsigned int mesh, const float depth, const unsigned int index)
+{
+    RenderItem item;
+    item.key = makeKey(pass, shader, material, mesh, depth);
+    item.index = index;
+    items.push_back(item);
+}
+
+void RenderQueue::sort()
+{
+    // LSD radix sort on 8-bit digits, skipping digits where every key is the same
+    unsigned int n = static_cast<unsigned int>(items.size());
+    if (jobs && jobs->size() > 1 && n >= parallelSortSize)
+    {
+        sortParallel();
+        countStateChanges();
+        return;
+    }
+
+    scratch.resize(n);
+    RenderItem *src = items.data();
+    RenderItem *dst = scratch.data();
+    for (unsigned int shift = 0; shift < 64; shift += 8)
+    {
+        unsigned int count[256] = { 0 };
+        for (unsigned int i = 0; i < n; i++)
+            count[(src[i].key >> shift) & 0xff]++;
+
+        if (n == 0 || count[(src[0].key >> shift) & 0xff] == n)
+            continue;
+
+        unsigned int offset = 0;
+        for (unsigned int d = 0; d < 256; d++)
+        {
+            unsigned int c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+        for (unsigned int i = 0; i < n; i++)
+            dst[count[(src[i].key >> shift) & 0xff]++] = src[i];
+        std::swap(src, dst);
+    }
+    if (src != items.data())
+        items.swap(scratch);
+
+    countStateChanges();
+}
+
+void RenderQueue::sortParallel()
+{
+    // Each chunk counts its digits, the counts give every chunk its own output
+    // ranges so the scatter is stable and needs no synchronisation
+    unsigned int n = static_cast<unsigned int>(items.size());
+    unsigned int numChunks = 4 * jobs->size();
+    unsigned int chunkSize = (n + numChunks - 1) / numChunks;
+    scratch.resize(n);
+    chunkCounts.resize(numChunks * 256);
+    RenderItem *src = items.data();
+    RenderItem *dst = scratch.data();
+    for (unsigned int shift = 0; shift < 64; shift += 8)
+    {
+        jobs->parallelFor(0, numChunks, [&](unsigned int firstChunk, unsigned int lastChunk)
+        {
+            for (unsigned int c = firstChunk; c < lastChunk; c++)
+            {
+                unsigned int *count = &chunkCounts[c * 256];
+                std::fill(count, count + 256, 0u);
+                unsigned int last = std::min(n, (c + 1) * chunkSize);
+                for (unsigned int i = c * chunkSize; i < last; i++)
+                    count[(src[i].key >> shift) & 0xff]++;
+            }
+        }, 1);
+
+        // Digit-major prefix sum over the chunks
+        unsigned int offset = 0;
+        unsigned int firstDigit = (src[0].key >> shift) & 0xff;
+        unsigned int firstDigitCount = 0;
+        for (unsigned int d = 0; d < 256; d++)
+            for (unsigned int c = 0; c < numChunks; c++)
+            {
+                unsigned int count = chunkCounts[c * 256 + d];
+                if (d == firstDigit)
+                    firstDigitCount += count;
+                chunkCounts[c * 256 + d] = offset;
+                offset += count;
+            }
+        if (firstDigitCount == n)
+            continue;
+
+        jobs->parallelFor(0, numChunks, [&](unsigned int firstChunk, unsigned int lastChunk)
+        {
+            for (unsigned int c = firstChunk; c < lastChunk; c++)
+            {
+                unsigned int *offsets = &chunkCounts[c * 256];
+                unsigned int last = std::min(n, (c + 1) * chunkSize);
+                for (unsigned int i = c * chunkSize; i < last; i++)
+                    dst[offsets[(src[i].key >> shift) & 0xff]++] = src[i];
+            }
+        }, 1);
+        std::swap(src, dst);
+    }
+    if (src != items.data())
+        items.swap(scratch);
+}
+
+void RenderQueue::countStateChanges()
+{
+    // Count the state changes a submission in this order will make
+    unsigned int n = static_cast<unsigned int>(items.size());
+    stats = RenderQueueStats();
+    stats.drawCalls = n;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        uint64_t key = items[i].key;
+        if (i == 0 || shader(key) != shader(items[i - 1].key))
+            stats.shaderChanges++;
+        if (i == 0 || material(key) != material(items[i - 1].key))
+            stats.materialChanges++;
+        if (i == 0 || mesh(key) != mesh(items[i - 1].key))
+            stats.meshChanges++;
+    }
+}
+
+void RenderQueue::clear()
+{
+    items.clear();
+}
+
+static uint64_t state(const uint64_t key)
+{
+    if (RenderQueue::pass(key) == PassOpaque)
+        return key >> (depthBits + 8);
+    return key >> 8;
+}
+
+RenderPass RenderQueue::pass(const uint64_t key)
+{
+    return static_cast<RenderPass>(key >> 62);
+}
+
+unsigned int RenderQueue::shader(const uint64_t key)
+{
+    return static_cast<unsigned int>(state(key) >> (materialBits + meshBits)) & ((1u << shaderBits) - 1);
+}
+
+unsigned int RenderQueue::material(const uint64_t key)
+{
+    return static_cast<unsigned int>(state(key) >> meshBits) & ((1u << materialBits) - 1);
+}
+
+unsigned int RenderQueue::mesh(const uint64_t key)
+{
+    return static_cast<unsigned int>(state(key)) & ((1u << meshBits) - 1);
+}
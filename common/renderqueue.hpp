@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+class JobSystem;
+
+// Sort key layout (most significant bits first)
+//   opaque:      pass(2) | shader(6) | material(12) | mesh(12) | depth(24)      | unused(8)
+//   transparent: pass(2) | inverse depth(24)       | shader(6) | material(12)   | mesh(12) | unused(8)
+// Opaque draws are grouped by state and then drawn front-to-back, transparent
+// draws are strictly back-to-front.
+enum RenderPass
+{
+    PassOpaque = 0,
+    PassTransparent = 1
+};
+
+struct RenderItem
+{
+    uint64_t key;
+    unsigned int index;
+};
+
+struct RenderQueueStats
+{
+    unsigned int drawCalls = 0;
+    unsigned int shaderChanges = 0;
+    unsigned int materialChanges = 0;
+    unsigned int meshChanges = 0;
+};
+
+class RenderQueue
+{
+public:
+    std::vector<RenderItem> items;
+    RenderQueueStats stats;
+
+    // Large queues are sorted with parallel passes when set
+    JobSystem *jobs = NULL;
+
+    // Add a draw, depth is the view depth normalised to [0, 1]
+    void add(const RenderPass pass, const unsigned int shader, const unsigned int material,
+             const unsigned int mesh, const float depth, const unsigned int index);
+
+    // Sort key of a draw
+    static uint64_t makeKey(const RenderPass pass, const unsigned int shader, const unsigned int material,
+                            const unsigned int mesh, const float depth);
+
+    // Radix sort the items and count the state changes needed to submit them
+    void sort();
+    void clear();
+
+    // Decode fields from a key
+    static RenderPass pass(const uint64_t key);
+    static unsigned int shader(const uint64_t key);
+    static unsigned int material(const uint64_t key);
+    static unsigned int mesh(const uint64_t key);
+
+private:
+    std::vector<RenderItem> scratch;
+    std::vector<unsigned int> chunkCounts;
+
+    void sortParallel();
+    void countStateChanges();
+};
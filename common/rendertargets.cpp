@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include <common/rendertargets.hpp>
+
+// GL formats of each target format
+static const GLenum internalFormats[numTargetFormats] = { GL_RGBA8, GL_RG8, GL_RG16F, GL_RGBA16F, GL_DEPTH_COMPONENT24, GL_DEPTH24_STENCIL8 };
+static const GLenum pixelFormats[numTargetFormats] = { GL_RGBA, GL_RG, GL_RG, GL_RGBA, GL_DEPTH_COMPONENT, GL_DEPTH_STENCIL };
+static const GLenum pixelTypes[numTargetFormats] = { GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE, GL_FLOAT, GL_FLOAT, GL_UNSIGNED_INT, GL_UNSIGNED_INT_24_8 };
+
+static bool isDepth(const TargetFormat format)
+{
+    return format == TargetDepth24 || format == TargetDepth24Stencil8;
+}
+
+void RenderTargetPool::acquire(const RenderGraph &graph)
+{
+    for (unsigned int t = 0; t < targets.size(); t++)
+        targets[t].used = false;
+
+    // Hand each physical target an unused texture of its description or a new one
+    std::vector<unsigned int> physicalTextures(graph.physicalTargets.size());
+    for (unsigned int p = 0; p < graph.physicalTargets.size(); p++)
+    {
+        const TargetDesc &desc = graph.physicalTargets[p];
+        unsigned int t = 0;
+        while (t < targets.size() && (targets[t].used || !(targets[t].desc == desc)))
+            t++;
+        if (t == targets.size())
+        {
+            Target target;
+            target.desc = desc;
+            glGenTextures(1, &target.texture);
+            if (desc.samples > 0)
+            {
+                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target.texture);
+                glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, internalFormats[desc.format], desc.width, desc.height, GL_TRUE);
+                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+            }
+            else
+            {
+                // Colour is filtered for the upscaling and post-process passes
+                GLenum filter = isDepth(desc.format) ? GL_NEAREST : GL_LINEAR;
+                glBindTexture(GL_TEXTURE_2D, target.texture);
+                glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[desc.format], desc.width, desc.height, 0,
+                             pixelFormats[desc.format], pixelTypes[desc.format], NULL);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glBindTexture(GL_TEXTURE_2D, 0);
+            }
+            targets.push_back(target);
+            allocatedBytes += desc.bytes();
+        }
+        targets[t].used = true;
+        targets[t].unusedFrames = 0;
+        physicalTextures[p] = targets[t].texture;
+    }
+
+    // Free the textures no frame has wanted for a while
+    for (int t = static_cast<int>(targets.size()) - 1; t >= 0; t--)
+        if (!targets[t].used && ++targets[t].unusedFrames > maxUnusedFrames)
+            freeTarget(t);
+    numTextures = static_cast<unsigned int>(targets.size());
+
+    textures.resize(graph.physical.size());
+    descs.resize(graph.physical.size());
+    for (unsigned int r = 0; r < graph.physical.size(); r++)
+    {
+        descs[r] = graph.desc(r);
+        if (graph.imported(r))
+            textures[r] = graph.handle(r);
+        else
+            textures[r] = graph.physical[r] >= 0 ? physicalTextures[graph.physical[r]] : 0;
+    }
+}
+
+unsigned int RenderTargetPool::texture(const unsigned int resource) const
+{
+    return textures[resource];
+}
+
+unsigned int RenderTargetPool::framebuffer(const std::vector<unsigned int> &colours, const int depth)
+{
+    std::vector<unsigned int> key;
+    for (unsigned int c = 0; c < colours.size(); c++)
+    {
+        if (textures[colours[c]] == 0)
+            return 0;
+        key.push_back(textures[colours[c]]);
+    }
+    if (depth >= 0 && textures[depth] == 0)
+        return 0;
+    key.push_back(depth >= 0 ? textures[depth] : 0);
+
+    std::map<std::vector<unsigned int>, unsigned int>::iterator found = framebuffers.find(key);
+    if (found != framebuffers.end())
+        return found->second;
+
+    unsigned int fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    std::vector<GLenum> drawBuffers;
+    for (unsigned int c = 0; c < colours.size(); c++)
+    {
+        const TargetDesc &desc = descs[colours[c]];
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + c, desc.samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D,
+                               textures[colours[c]], 0);
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + c);
+    }
+    if (depth >= 0)
+    {
+        const TargetDesc &desc = descs[depth];
+        glFramebufferTexture2D(GL_FRAMEBUFFER, desc.format == TargetDepth24Stencil8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+                               desc.samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, textures[depth], 0);
+    }
+    if (drawBuffers.empty())
+    {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    else
+        glDrawBuffers(static_cast<int>(drawBuffers.size()), &drawBuffers[0]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        printf("Render targets: framebuffer of %u attachments incomplete\n", static_cast<unsigned int>(key.size()));
+
+    framebuffers[key] = fbo;
+    return fbo;
+}
+
+unsigned int RenderTargetPool::framebuffer(const int colour, const int depth)
+{
+    std::vector<unsigned int> colours;
+    if (colour >= 0)
+        colours.push_back(colour);
+    return framebuffer(colours, depth);
+}
+
+void RenderTargetPool::freeTarget(const unsigned int index)
+{
+    // Framebuffers with the texture attached go with it
+    unsigned int texture = targets[index].texture;
+    std::map<std::vector<unsigned int>, unsigned int>::iterator f = framebuffers.begin();
+    while (f != framebuffers.end())
+    {
+        if (std::find(f->first.begin(), f->first.end(), texture) != f->first.end())
+        {
+            glDeleteFramebuffers(1, &f->second);
+            f = framebuffers.erase(f);
+        }
+        else
+            ++f;
+    }
+    glDeleteTextures(1, &texture);
+    allocatedBytes -= targets[index].desc.bytes();
+    targets.erase(targets.begin() + index);
+}
+
+void RenderTargetPool::deleteBuffers()
+{
+    for (std::map<std::vector<unsigned int>, unsigned int>::iterator f = framebuffers.begin(); f != framebuffers.end(); ++f)
+        glDeleteFramebuffers(1, &f->second);
+    framebuffers.clear();
+    for (unsigned int t = 0; t < targets.size(); t++)
+        glDeleteTextures(1, &targets[t].texture);
+    targets.clear();
+    allocatedBytes = 0;
+    numTextures = 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <map>
+
+#include <GL/glew.h>
+
+#include <common/rendergraph.hpp>
+
+// GL textures behind a render graph's physical targets. Textures are kept
+// between frames and handed to the physical target of the same description
+// each frame, ones unused for a while are freed so switching paths or modes
+// gives their memory back. Framebuffers are cached by their attachments.
+class RenderTargetPool
+{
+public:
+    // Frames a texture may go unused before it is freed
+    unsigned int maxUnusedFrames = 60;
+
+    // Statistics
+    unsigned int allocatedBytes = 0;
+    unsigned int numTextures = 0;
+
+    // Match the compiled graph's physical targets to textures, creating the missing ones
+    void acquire(const RenderGraph &graph);
+
+    // Texture of a resource this frame, the handle of an imported one
+    unsigned int texture(const unsigned int resource) const;
+
+    // Framebuffer with the given colour resources and an optional depth resource. The
+    // default framebuffer's handle is 0, a resource imported with handle 0 stands for it.
+    unsigned int framebuffer(const std::vector<unsigned int> &colours, const int depth = -1);
+    unsigned int framebuffer(const int colour, const int depth = -1);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    struct Target
+    {
+        TargetDesc desc;
+        unsigned int texture;
+        unsigned int unusedFrames;
+        bool used;
+    };
+
+    std::vector<Target> targets;
+
+    // Texture and description of each resource this frame
+    std::vector<unsigned int> textures;
+    std::vector<TargetDesc> descs;
+
+    // Framebuffers keyed by their colour textures followed by the depth texture
+    std::map<std::vector<unsigned int>, unsigned int> framebuffers;
+
+    void freeTarget(const unsigned int index);
+};
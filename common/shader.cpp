@@ -91,4 +91,74 @@ GLuint LoadShaders(const char* vertex_file_path, const char* fragment_file_path)
     glDeleteShader(fragment_shader_id);
 
     return program_id;
-}
\ No newline at end of file
+}
+
+// Compile a single shader stage from a file, returns 0 on failure
+static GLuint compileShaderFile(GLenum type, const char* file_path) {
+    std::string shader_code;
+    std::ifstream shader_stream(file_path, std::ios::in);
+    if (shader_stream.is_open()) {
+        std::stringstream sstr;
+        sstr << shader_stream.rdbuf();
+        shader_code = sstr.str();
+        shader_stream.close();
+    }
+    else {
+        std::cerr << "Error: Failed to open shader file: " << file_path << std::endl;
+        return 0;
+    }
+
+    std::cout << "Compiling shader: " << file_path << std::endl;
+    GLuint shader_id = glCreateShader(type);
+    const char* source_ptr = shader_code.c_str();
+    glShaderSource(shader_id, 1, &source_ptr, nullptr);
+    glCompileShader(shader_id);
+
+    GLint success = GL_FALSE;
+    int info_log_length;
+    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &info_log_length);
+    if (info_log_length > 0) {
+        std::vector<char> error_message(info_log_length + 1);
+        glGetShaderInfoLog(shader_id, info_log_length, nullptr, &error_message[0]);
+        std::cerr << "Shader error:\n" << &error_message[0] << std::endl;
+    }
+
+    return shader_id;
+}
+
+GLuint LoadTransformFeedbackShaders(const char* vertex_file_path, const char* geometry_file_path,
+                                    const char* const* varyings, int num_varyings) {
+    GLuint vertex_shader_id = compileShaderFile(GL_VERTEX_SHADER, vertex_file_path);
+    GLuint geometry_shader_id = geometry_file_path ? compileShaderFile(GL_GEOMETRY_SHADER, geometry_file_path) : 0;
+    if (vertex_shader_id == 0 || (geometry_file_path && geometry_shader_id == 0))
+        return 0;
+
+    // The captured varyings must be declared before linking
+    std::cout << "Linking transform feedback program..." << std::endl;
+    GLuint program_id = glCreateProgram();
+    glAttachShader(program_id, vertex_shader_id);
+    if (geometry_shader_id)
+        glAttachShader(program_id, geometry_shader_id);
+    glTransformFeedbackVaryings(program_id, num_varyings, varyings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program_id);
+
+    GLint success = GL_FALSE;
+    int info_log_length;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &success);
+    glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &info_log_length);
+    if (info_log_length > 0) {
+        std::vector<char> error_message(info_log_length + 1);
+        glGetProgramInfoLog(program_id, info_log_length, nullptr, &error_message[0]);
+        std::cerr << "Shader program linking error:\n" << &error_message[0] << std::endl;
+    }
+
+    glDetachShader(program_id, vertex_shader_id);
+    glDeleteShader(vertex_shader_id);
+    if (geometry_shader_id) {
+        glDetachShader(program_id, geometry_shader_id);
+        glDeleteShader(geometry_shader_id);
+    }
+
+    return program_id;
+}
@@ -11,4 +11,13 @@ GLuint LoadShaders(
     const char* fragment_file_path
 );
 
+// Vertex (and optional geometry) program whose outputs are captured with
+// transform feedback, varyings are interleaved in the order given
+GLuint LoadTransformFeedbackShaders(
+    const char* vertex_file_path,
+    const char* geometry_file_path,
+    const char* const* varyings,
+    int num_varyings
+);
+
 #endif // SHADER_HPP
\ No newline at end of file
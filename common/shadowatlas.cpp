@@ -0,0 +1,229 @@
+#include <cmath>
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/shadowatlas.hpp>
+
+// Cascades are rendered this much larger than the view slice they cover, so
+// the camera can move that far before they have to be re-rendered
+static const float cascadeMargin = 0.2f;
+
+// Depth kept behind a cascade for casters between it and the light
+static const float casterDistance = 50.0f;
+
+// Near plane of the spot and point light projections
+static const float localNear = 0.05f;
+
+// Up vector for a view along direction
+static glm::vec3 upFor(const glm::vec3 &direction)
+{
+    return fabsf(direction.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+}
+
+ShadowAtlas::ShadowAtlas(const int size, const int tileSize)
+{
+    this->size = size;
+    this->tileSize = tileSize;
+
+    int tilesPerRow = size / tileSize;
+    unsigned int numTiles = std::min(static_cast<unsigned int>(tilesPerRow * tilesPerRow), maxShadowTiles);
+    tiles.resize(numTiles);
+    for (unsigned int t = 0; t < numTiles; t++)
+    {
+        // The w component is half a texel in tile co-ordinates, for clamping filtered lookups inside the tile
+        tiles[t].x = (t % tilesPerRow) * tileSize;
+        tiles[t].y = (t / tilesPerRow) * tileSize;
+        tiles[t].rect = glm::vec4(static_cast<float>(tiles[t].x) / size, static_cast<float>(tiles[t].y) / size,
+                                  static_cast<float>(tileSize) / size, 0.5f / tileSize);
+    }
+    for (unsigned int c = 0; c < numCascades; c++)
+        cascadeSplits[c] = 0.0f;
+}
+
+unsigned int ShadowAtlas::tileCount(const LightSource &light)
+{
+    if (light.type == 3)
+        return numCascades;
+    if (light.type == 2)
+        return 1;
+    if (light.type == 1)
+        return 6;
+    return 0;
+}
+
+ShadowAtlas::Fit ShadowAtlas::fitCascade(const ShadowTile &tile, const LightSource &light, const unsigned int cascade,
+                                         const glm::mat4 &cameraWorld, const glm::mat4 &projection, const float near)
+{
+    // Bounding sphere of the view slice, its radius only depends on the projection
+    float d0 = cascade == 0 ? near : cascadeSplits[cascade - 1];
+    float d1 = cascadeSplits[cascade];
+    float k2 = 1.0f / (projection[0][0] * projection[0][0]) + 1.0f / (projection[1][1] * projection[1][1]);
+    float depth = std::min(d1, 0.5f * (d0 + d1) * (1.0f + k2));
+    float radius = std::max(sqrtf((d1 - depth) * (d1 - depth) + d1 * d1 * k2),
+                            sqrtf((depth - d0) * (depth - d0) + d0 * d0 * k2));
+    glm::vec3 centre = glm::vec3(cameraWorld[3]) - depth * glm::vec3(cameraWorld[2]);
+
+    Fit fit;
+    fit.direction = glm::normalize(light.direction);
+    fit.radius = radius;
+    glm::mat4 rotation = glm::lookAt(glm::vec3(0.0f), fit.direction, upFor(fit.direction));
+    fit.centre = glm::vec3(rotation * glm::vec4(centre, 1.0f));
+
+    // Still covered by the cached tile
+    glm::vec3 offset = glm::abs(fit.centre - tile.centre);
+    float slack = cascadeMargin * radius;
+    fit.stale = !tile.valid || tile.dirty || tile.direction != fit.direction || tile.radius != radius ||
+                offset.x > slack || offset.y > slack || offset.z > slack;
+    if (!fit.stale)
+        return fit;
+
+    // Snap the centre to whole texels so re-rendered cascades do not shimmer
+    float extent = radius * (1.0f + cascadeMargin);
+    float texel = 2.0f * extent / tileSize;
+    fit.centre.x = floorf(fit.centre.x / texel) * texel;
+    fit.centre.y = floorf(fit.centre.y / texel) * texel;
+    fit.view = glm::translate(glm::mat4(1.0f), -fit.centre) * rotation;
+    fit.projection = glm::ortho(-extent, extent, -extent, extent, -(extent + casterDistance), extent);
+    return fit;
+}
+
+ShadowAtlas::Fit ShadowAtlas::fitLocal(const ShadowTile &tile, const LightSource &light, const unsigned int face)
+{
+    Fit fit;
+    fit.centre = light.position;
+    fit.radius = std::min(Light::influenceRadius(light), shadowDistance);
+    if (light.type == 2)
+    {
+        // The cone plus the shaders' 2 degree fade and a degree to spare
+        fit.direction = glm::normalize(light.direction);
+        float angle = std::min(acosf(std::min(std::max(light.cosPhi, -1.0f), 1.0f)) + glm::radians(3.0f), glm::radians(80.0f));
+        fit.view = glm::lookAt(light.position, light.position + fit.direction, upFor(fit.direction));
+        fit.projection = glm::perspective(2.0f * angle, 1.0f, localNear, std::max(fit.radius, 2.0f * localNear));
+    }
+    else
+    {
+        static const glm::vec3 axes[6] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+                                           glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+        static const glm::vec3 ups[6] = { glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),
+                                          glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0) };
+        fit.direction = axes[face];
+        fit.view = glm::lookAt(light.position, light.position + axes[face], ups[face]);
+        fit.projection = glm::perspective(glm::radians(90.0f), 1.0f, localNear, std::max(fit.radius, 2.0f * localNear));
+    }
+    fit.stale = !tile.valid || tile.dirty || fit.view != tile.view || fit.projection != tile.projection;
+    return fit;
+}
+
+void ShadowAtlas::update(std::vector<LightSource> &lights, const glm::mat4 &view, const glm::mat4 &projection, const float near)
+{
+    // Give tiles to shadow casting lights that have none, the scene's lights keep their indices
+    if (lightTiles.size() < lights.size())
+        lightTiles.resize(lights.size(), -1);
+    for (unsigned int i = 0; i < lights.size(); i++)
+    {
+        lights[i].shadowTile = -1;
+        unsigned int count = tileCount(lights[i]);
+        if (!lights[i].castShadows || lightTiles[i] >= 0 || count == 0 || numAllocated + count > tiles.size())
+            continue;
+        lightTiles[i] = numAllocated;
+        for (unsigned int t = numAllocated; t < numAllocated + count; t++)
+        {
+            tiles[t].light = i;
+            tiles[t].valid = false;
+        }
+        numAllocated += count;
+    }
+
+    // Split the cascades between linear and logarithmic spacing
+    for (unsigned int c = 0; c < numCascades; c++)
+    {
+        float f = static_cast<float>(c + 1) / numCascades;
+        float logSplit = near * powf(shadowDistance / near, f);
+        float linearSplit = near + (shadowDistance - near) * f;
+        cascadeSplits[c] = 0.75f * logSplit + 0.25f * linearSplit;
+    }
+
+    // Fit every tile and rank the stale ones, nearer cascades and lights first,
+    // raised by the frames they have waited so none is starved
+    glm::mat4 cameraWorld = glm::inverse(view);
+    glm::vec3 eye(cameraWorld[3]);
+    std::vector<Fit> fits(numAllocated);
+    std::vector<std::pair<float, unsigned int> > stale;
+    for (unsigned int t = 0; t < numAllocated; t++)
+    {
+        const LightSource &light = lights[tiles[t].light];
+        unsigned int index = t - lightTiles[tiles[t].light];
+        fits[t] = light.type == 3 ? fitCascade(tiles[t], light, index, cameraWorld, projection, near)
+                                  : fitLocal(tiles[t], light, index);
+        if (!fits[t].stale)
+            continue;
+
+        float priority = light.type == 3 ? 100.0f - 10.0f * index : std::max(50.0f - glm::length(light.position - eye), 0.0f);
+        priority += 10.0f * tiles[t].staleFrames + (tiles[t].valid ? 0.0f : 1000.0f);
+        stale.push_back(std::make_pair(priority, t));
+    }
+    numStale = static_cast<unsigned int>(stale.size());
+
+    // Tiles of the same light share a priority, the stable sort keeps them together
+    std::stable_sort(stale.begin(), stale.end(), [](const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b)
+    {
+        return a.first > b.first;
+    });
+    refreshTiles.clear();
+    for (unsigned int s = 0; s < stale.size(); s++)
+    {
+        ShadowTile &tile = tiles[stale[s].second];
+        if (s >= updateBudget)
+        {
+            tile.staleFrames++;
+            continue;
+        }
+        const Fit &fit = fits[stale[s].second];
+        tile.view = fit.view;
+        tile.projection = fit.projection;
+        tile.centre = fit.centre;
+        tile.direction = fit.direction;
+        tile.radius = fit.radius;
+        tile.valid = true;
+        tile.dirty = false;
+        tile.staleFrames = 0;
+        refreshTiles.push_back(stale[s].second);
+    }
+
+    // A light is shadowed once all of its tiles hold a depth map
+    numShadowedLights = 0;
+    for (unsigned int i = 0; i < lights.size(); i++)
+    {
+        if (!lights[i].castShadows || lightTiles[i] < 0)
+            continue;
+        bool complete = true;
+        for (unsigned int t = lightTiles[i]; t < lightTiles[i] + tileCount(lights[i]); t++)
+            complete = complete && tiles[t].valid;
+        if (complete)
+        {
+            lights[i].shadowTile = lightTiles[i];
+            numShadowedLights++;
+        }
+    }
+}
+
+void ShadowAtlas::invalidate(const AABB &box)
+{
+    for (unsigned int t = 0; t < numAllocated; t++)
+    {
+        ShadowTile &tile = tiles[t];
+        if (!tile.valid)
+            continue;
+
+        // Cascades cover the whole view, local lights only their influence sphere
+        if (tile.projection[3][3] == 1.0f)
+            tile.dirty = true;
+        else
+        {
+            glm::vec3 closest = glm::clamp(tile.centre, box.min, box.max);
+            if (glm::dot(closest - tile.centre, closest - tile.centre) <= tile.radius * tile.radius)
+                tile.dirty = true;
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <common/maths.hpp>
+#include <common/light.hpp>
+
+// Must match maxShadowTiles and numCascades in the shaders
+const unsigned int maxShadowTiles = 16;
+const unsigned int numCascades = 3;
+
+// A square region of the shadow atlas and the light space it was last rendered from
+struct ShadowTile
+{
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+
+    // Pixel origin in the atlas and texture co-ordinate offset and scale
+    int x = 0, y = 0;
+    glm::vec4 rect;
+
+    // Owning light, -1 when free
+    int light = -1;
+
+    // Holds a depth map, and whether the static geometry under it has changed since
+    bool valid = false;
+    bool dirty = false;
+
+    // Frames spent stale without being refreshed
+    unsigned int staleFrames = 0;
+
+    // What the tile was fitted to: light space centre and light direction for
+    // cascades, position and influence radius for local lights
+    glm::vec3 centre;
+    glm::vec3 direction;
+    float radius = 0.0f;
+};
+
+// Shadow map bookkeeping for the three light types, shared by one depth
+// atlas of equal tiles. Directional lights take numCascades tiles, spot
+// lights one and point lights six, one per cube face (+x, -x, +y, -y, +z, -z).
+// Tiles hold the static geometry's depth and are only re-rendered when their
+// light moves, the camera leaves a cascade's margin or static geometry under
+// them changes, at most updateBudget tiles per frame. Stale tiles keep the
+// matrices they were rendered with, so their shadows stay consistent until
+// their turn comes. Dynamic objects are drawn over the tiles every frame.
+class ShadowAtlas
+{
+public:
+    // Atlas and tile size in texels
+    int size, tileSize;
+    std::vector<ShadowTile> tiles;
+
+    // Cascades cover the view out to shadowDistance, split at these view depths
+    float shadowDistance = 60.0f;
+    float cascadeSplits[numCascades];
+
+    // Tiles whose static depth is re-rendered this frame
+    unsigned int updateBudget = 4;
+    std::vector<unsigned int> refreshTiles;
+
+    // Statistics for the last update
+    unsigned int numStale = 0;
+    unsigned int numShadowedLights = 0;
+
+    // Constructor
+    ShadowAtlas(const int size = 4096, const int tileSize = 1024);
+
+    // Allocate tiles to newly shadow casting lights, find the stale tiles and
+    // pick the ones refreshed this frame, then set each light's shadowTile
+    void update(std::vector<LightSource> &lights, const glm::mat4 &view, const glm::mat4 &projection, const float near);
+
+    // Mark the tiles whose light reaches a changed static box
+    void invalidate(const AABB &box);
+
+    // Number of tiles a light takes
+    static unsigned int tileCount(const LightSource &light);
+
+private:
+    // First tile of each light, -1 for none
+    std::vector<int> lightTiles;
+    unsigned int numAllocated = 0;
+
+    // Light space view and projection a tile of a light should have this frame
+    struct Fit
+    {
+        glm::mat4 view, projection;
+        glm::vec3 centre, direction;
+        float radius;
+        bool stale;
+    };
+    Fit fitCascade(const ShadowTile &tile, const LightSource &light, const unsigned int cascade,
+                   const glm::mat4 &cameraWorld, const glm::mat4 &projection, const float near);
+    Fit fitLocal(const ShadowTile &tile, const LightSource &light, const unsigned int face);
+};
@@ -0,0 +1,118 @@
+#include <stdio.h>
+
+#include <common/shadowmaps.hpp>
+
+ShadowMaps::ShadowMaps(const ShadowAtlas &atlas)
+{
+    tileSize = atlas.tileSize;
+    dynamicTiles.resize(atlas.tiles.size(), false);
+
+    // Depth textures compared in the sampler, filtered lookups give 2x2 PCF
+    glGenTextures(2, textures);
+    glGenFramebuffers(2, framebuffers);
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, atlas.size, atlas.size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[i], 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            printf("Shadows: atlas %u incomplete\n", i);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    printf("Shadows: %dx%d atlas of %u tiles, %d KB per atlas\n", atlas.size, atlas.size,
+           static_cast<unsigned int>(atlas.tiles.size()), atlas.size * atlas.size * 4 / 1024);
+}
+
+void ShadowMaps::beginTile(const unsigned int index, const ShadowTile &tile, const bool dynamic)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[dynamic ? 1 : 0]);
+    glViewport(tile.x, tile.y, tileSize, tileSize);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(tile.x, tile.y, tileSize, tileSize);
+    glDepthMask(GL_TRUE);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    if (dynamic)
+        dynamicTiles[index] = true;
+
+    // Slope scaled bias and back faces keep lit surfaces from shadowing themselves
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+    glCullFace(GL_FRONT);
+}
+
+void ShadowMaps::clearDynamic(const std::vector<ShadowTile> &tiles)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[1]);
+    glEnable(GL_SCISSOR_TEST);
+    glDepthMask(GL_TRUE);
+    for (unsigned int t = 0; t < dynamicTiles.size(); t++)
+    {
+        if (!dynamicTiles[t])
+            continue;
+        glScissor(tiles[t].x, tiles[t].y, tileSize, tileSize);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        dynamicTiles[t] = false;
+    }
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void ShadowMaps::end(const int width, const int height)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glCullFace(GL_BACK);
+}
+
+void ShadowMaps::bind(unsigned int shaderID, StreamBuffer &streamBuffer, const std::vector<ShadowTile> &tiles,
+                      const float *cascadeSplits, const glm::mat4 &view)
+{
+    // View space to tile co-ordinates, [-1, 1] clip space mapped to [0, 1]
+    ShadowUniforms block = {};
+    glm::mat4 bias(0.5f, 0.0f, 0.0f, 0.0f,
+                   0.0f, 0.5f, 0.0f, 0.0f,
+                   0.0f, 0.0f, 0.5f, 0.0f,
+                   0.5f, 0.5f, 0.5f, 1.0f);
+    block.viewToWorld = glm::inverse(view);
+    for (unsigned int t = 0; t < tiles.size() && t < maxShadowTiles; t++)
+    {
+        block.matrices[t] = bias * tiles[t].projection * tiles[t].view * block.viewToWorld;
+        block.rects[t] = tiles[t].rect;
+    }
+    for (unsigned int c = 0; c < numCascades; c++)
+        block.cascadeSplits[c] = cascadeSplits[c];
+
+    size_t offset;
+    if (streamBuffer.write(&block, sizeof(block), streamBuffer.uniformAlignment, offset))
+        glBindBufferRange(GL_UNIFORM_BUFFER, shadowBlockBinding, streamBuffer.buffer, offset, sizeof(block));
+
+    glUseProgram(shaderID);
+    const char *names[2] = { "staticShadows", "dynamicShadows" };
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glUniform1i(glGetUniformLocation(shaderID, names[i]), firstUnit + i);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void ShadowMaps::deleteBuffers()
+{
+    glDeleteFramebuffers(2, framebuffers);
+    glDeleteTextures(2, textures);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/shadowatlas.hpp>
+#include <common/streambuffer.hpp>
+
+// Shadow tiles as laid out in the shaders' ShadowBlock (std140). The
+// matrices take view space to tile co-ordinates in [0, 1], the rects place
+// the tiles in the atlas.
+struct ShadowUniforms
+{
+    glm::mat4 matrices[maxShadowTiles];
+    glm::vec4 rects[maxShadowTiles];
+    glm::mat4 viewToWorld;
+    glm::vec4 cascadeSplits;
+};
+
+// GL side of the shadow atlas. Static geometry is rendered into a cached
+// atlas that is only touched for refreshed tiles, dynamic objects into a
+// second atlas cleared every frame, and the lighting shader takes the
+// nearer of the two depths.
+class ShadowMaps
+{
+public:
+    // Constructor
+    ShadowMaps(const ShadowAtlas &atlas);
+
+    // Bind and clear a tile of the static or dynamic atlas, the caller then draws
+    // depth-only with the tile's view and projection
+    void beginTile(const unsigned int index, const ShadowTile &tile, const bool dynamic);
+
+    // Clear the dynamic tiles drawn last frame
+    void clearDynamic(const std::vector<ShadowTile> &tiles);
+
+    // Restore the default framebuffer and state
+    void end(const int width, const int height);
+
+    // Write ShadowBlock for this frame's view and bind the atlases to a lighting program
+    void bind(unsigned int shaderID, StreamBuffer &streamBuffer, const std::vector<ShadowTile> &tiles,
+              const float *cascadeSplits, const glm::mat4 &view);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    // Texture units above the clustered lighting buffers
+    static const unsigned int firstUnit = 11;
+
+    int tileSize;
+
+    // Static and dynamic atlases
+    unsigned int textures[2];
+    unsigned int framebuffers[2];
+
+    // Dynamic tiles drawn since the last clear
+    std::vector<bool> dynamicTiles;
+};
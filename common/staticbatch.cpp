@@ -0,0 +1,187 @@
+#include <cmath>
+#include <cfloat>
+#include <cstddef>
+#include <algorithm>
+
+#include <common/staticbatch.hpp>
+#include <common/materials.hpp>
+
+bool StaticBatch::ChunkKey::operator<(const ChunkKey &other) const
+{
+    if (material != other.material) return material < other.material;
+    if (object != other.object) return object < other.object;
+    if (x != other.x) return x < other.x;
+    if (y != other.y) return y < other.y;
+    return z < other.z;
+}
+
+StaticBatch::StaticBatch(const float chunkSize)
+{
+    this->chunkSize = chunkSize;
+}
+
+void StaticBatch::add(Model *model, const glm::mat4 &modelMatrix, const int material)
+{
+    // World space bounds of the object
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    for (unsigned int i = 0; i < model->vertices.size(); i++)
+    {
+        glm::vec3 position = glm::vec3(modelMatrix * glm::vec4(model->vertices[i], 1.0f));
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+
+    // Objects are assigned to the cell containing the centre of their bounds. Ones larger
+    // than a cell get a chunk of their own so they do not stretch a cell's bounds over
+    // the geometry around them.
+    glm::vec3 centre = 0.5f * (boundsMin + boundsMax);
+    glm::vec3 size = boundsMax - boundsMin;
+    ChunkKey key;
+    key.material = model;
+    key.object = std::max(size.x, std::max(size.y, size.z)) > chunkSize ? numOversized++ : -1;
+    key.x = static_cast<int>(floor(centre.x / chunkSize));
+    key.y = static_cast<int>(floor(centre.y / chunkSize));
+    key.z = static_cast<int>(floor(centre.z / chunkSize));
+
+    // Pre-transform the vertices into world space
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+    std::vector<PoolVertex> &vertices = pending[key];
+    for (unsigned int i = 0; i < model->vertices.size(); i++)
+    {
+        PoolVertex vertex;
+        vertex.position = glm::vec3(modelMatrix * glm::vec4(model->vertices[i], 1.0f));
+        vertex.uv = model->uvs[i];
+        vertex.normal = glm::normalize(normalMatrix * model->normals[i]);
+        vertices.push_back(vertex);
+    }
+    pendingMaterials[key].resize(vertices.size(), material);
+}
+
+void StaticBatch::build()
+{
+    // Concatenate the chunks into one vertex array
+    std::vector<PoolVertex> merged;
+    std::vector<int> materials;
+    for (auto it = pending.begin(); it != pending.end(); ++it)
+    {
+        const std::vector<PoolVertex> &vertices = it->second;
+        if (vertices.empty())
+            continue;
+        const std::vector<int> &vertexMaterials = pendingMaterials[it->first];
+        materials.insert(materials.end(), vertexMaterials.begin(), vertexMaterials.end());
+
+        StaticChunk chunk;
+        chunk.material = it->first.material;
+        chunk.first = static_cast<unsigned int>(merged.size());
+        chunk.count = static_cast<unsigned int>(vertices.size());
+        chunk.boundsMin = chunk.boundsMax = vertices[0].position;
+        for (unsigned int i = 0; i < vertices.size(); i++)
+        {
+            chunk.boundsMin = glm::min(chunk.boundsMin, vertices[i].position);
+            chunk.boundsMax = glm::max(chunk.boundsMax, vertices[i].position);
+        }
+        chunks.push_back(chunk);
+        merged.insert(merged.end(), vertices.begin(), vertices.end());
+    }
+    pending.clear();
+    pendingMaterials.clear();
+
+    printf("Static batch: %u chunks, %u vertices\n",
+           static_cast<unsigned int>(chunks.size()), static_cast<unsigned int>(merged.size()));
+    if (merged.empty())
+        return;
+
+    // Upload the merged geometry
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, merged.size() * sizeof(PoolVertex), &merged[0], GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PoolVertex), (void*)offsetof(PoolVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(PoolVertex), (void*)offsetof(PoolVertex, uv));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(PoolVertex), (void*)offsetof(PoolVertex, normal));
+    glGenBuffers(1, &materialBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, materialBuffer);
+    glBufferData(GL_ARRAY_BUFFER, materials.size() * sizeof(int), &materials[0], GL_STATIC_DRAW);
+    glEnableVertexAttribArray(materialAttribute);
+    glVertexAttribIPointer(materialAttribute, 1, GL_INT, 0, (void*)0);
+
+    std::vector<glm::vec3> positions(merged.size());
+    for (unsigned int i = 0; i < merged.size(); i++)
+        positions[i] = merged[i].position;
+    glGenVertexArrays(1, &depthVAO);
+    glBindVertexArray(depthVAO);
+    glGenBuffers(1, &positionBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool StaticBatch::bindTransform(unsigned int &shaderID, StreamBuffer &streamBuffer, const glm::mat4 &view, const glm::mat4 &projection)
+{
+    // Vertices are already in world space so the model matrix is the identity
+    ObjectUniforms object;
+    object.MVP = projection * view;
+    object.MV = view;
+    size_t offset;
+    if (!streamBuffer.write(&object, sizeof(ObjectUniforms), streamBuffer.uniformAlignment, offset))
+        return false;
+    streamBuffer.flush();
+    glBindBufferRange(GL_UNIFORM_BUFFER, objectBlockBinding, streamBuffer.buffer, offset, sizeof(ObjectUniforms));
+    glUniform1i(glGetUniformLocation(shaderID, "instanced"), 0);
+    return true;
+}
+
+void StaticBatch::draw(unsigned int &shaderID, StreamBuffer &streamBuffer, const std::vector<unsigned int> &visibleChunks,
+                       const glm::mat4 &view, const glm::mat4 &projection)
+{
+    drawCalls = 0;
+    if (visibleChunks.empty())
+        return;
+
+    if (!bindTransform(shaderID, streamBuffer, view, projection))
+        return;
+
+    // Chunks are ordered by material and culling keeps that order, so each material is bound once
+    Model *currentMaterial = NULL;
+    glBindVertexArray(VAO);
+    for (unsigned int c = 0; c < visibleChunks.size(); c++)
+    {
+        unsigned int i = visibleChunks[c];
+        if (chunks[i].material != currentMaterial)
+        {
+            chunks[i].material->bindMaterial(shaderID);
+            currentMaterial = chunks[i].material;
+        }
+        glDrawArrays(GL_TRIANGLES, chunks[i].first, chunks[i].count);
+        drawCalls++;
+    }
+    glBindVertexArray(0);
+}
+
+void StaticBatch::drawDepth(unsigned int &shaderID, StreamBuffer &streamBuffer, const std::vector<unsigned int> &visibleChunks,
+                            const glm::mat4 &view, const glm::mat4 &projection)
+{
+    if (visibleChunks.empty() || !bindTransform(shaderID, streamBuffer, view, projection))
+        return;
+
+    glBindVertexArray(depthVAO);
+    for (unsigned int c = 0; c < visibleChunks.size(); c++)
+        glDrawArrays(GL_TRIANGLES, chunks[visibleChunks[c]].first, chunks[visibleChunks[c]].count);
+    glBindVertexArray(0);
+}
+
+void StaticBatch::deleteBuffers()
+{
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &materialBuffer);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &positionBuffer);
+    glDeleteVertexArrays(1, &depthVAO);
+}
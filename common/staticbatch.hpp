@@ -0,0 +1,76 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/model.hpp>
+#include <common/geometrypool.hpp>
+#include <common/streambuffer.hpp>
+
+// A merged run of pre-transformed static geometry sharing one material
+struct StaticChunk
+{
+    Model *material;
+    unsigned int first;
+    unsigned int count;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+class StaticBatch
+{
+public:
+    std::vector<StaticChunk> chunks;
+
+    // Draw calls made by the last draw
+    unsigned int drawCalls = 0;
+
+    // Constructor, objects are grouped into cubic cells of the given size
+    StaticBatch(const float chunkSize);
+
+    // Add a static object at scene build time, its vertices carry the material table index
+    void add(Model *model, const glm::mat4 &modelMatrix, const int material = 0);
+
+    // Merge the added objects and upload them to the GPU
+    void build();
+
+    // Draw the visible chunks, one call each
+    void draw(unsigned int &shaderID, StreamBuffer &streamBuffer, const std::vector<unsigned int> &visibleChunks,
+              const glm::mat4 &view, const glm::mat4 &projection);
+
+    // Draw the visible chunks from the position-only stream without binding materials, for depth-only passes
+    void drawDepth(unsigned int &shaderID, StreamBuffer &streamBuffer, const std::vector<unsigned int> &visibleChunks,
+                   const glm::mat4 &view, const glm::mat4 &projection);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    float chunkSize;
+    unsigned int VAO = 0;
+    unsigned int vertexBuffer = 0;
+    unsigned int materialBuffer = 0;
+
+    // Positions only, so depth-only passes fetch a third of the vertex data
+    unsigned int depthVAO = 0;
+    unsigned int positionBuffer = 0;
+
+    // Stream the world space transform and bind it to the object block
+    bool bindTransform(unsigned int &shaderID, StreamBuffer &streamBuffer, const glm::mat4 &view, const glm::mat4 &projection);
+
+    // Geometry waiting to be merged, keyed by material and chunk cell, objects larger
+    // than a cell are keyed by their own index instead
+    struct ChunkKey
+    {
+        Model *material;
+        int object;
+        int x, y, z;
+        bool operator<(const ChunkKey &other) const;
+    };
+    std::map<ChunkKey, std::vector<PoolVertex> > pending;
+    std::map<ChunkKey, std::vector<int> > pendingMaterials;
+    int numOversized = 0;
+};
@@ -0,0 +1,124 @@
+#include <cstring>
+#include <stdio.h>
+
+#include <common/streambuffer.hpp>
+
+StreamBuffer::StreamBuffer(const size_t regionSize)
+{
+    this->regionSize = regionSize;
+    persistent = GLEW_ARB_buffer_storage != 0;
+
+    GLint alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniformAlignment = static_cast<size_t>(alignment);
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (persistent)
+    {
+        // One region per frame in flight, mapped once for the lifetime of the buffer
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, framesInFlight * regionSize, NULL, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, framesInFlight * regionSize, flags));
+    }
+    else
+    {
+        // Single region re-specified every frame, writes go to a CPU staging copy
+        glBufferData(GL_ARRAY_BUFFER, regionSize, NULL, GL_STREAM_DRAW);
+        staging.resize(regionSize);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    printf("Stream buffer: %s, %u KB per frame\n",
+           persistent ? "persistent mapping" : "orphaning", static_cast<unsigned int>(regionSize / 1024));
+}
+
+void StreamBuffer::beginFrame()
+{
+    regionOffset = 0;
+    flushedOffset = 0;
+
+    if (persistent)
+    {
+        // Wait until the GPU has finished with the frame that last used this region
+        region = (region + 1) % framesInFlight;
+        if (fences[region])
+        {
+            while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+            glDeleteSync(fences[region]);
+            fences[region] = 0;
+        }
+    }
+    else
+    {
+        // Orphan the old storage so the driver does not wait for in-flight draws
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, regionSize, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+bool StreamBuffer::write(const void *data, const size_t size, const size_t alignment, size_t &offset)
+{
+    size_t start = (regionOffset + alignment - 1) / alignment * alignment;
+    if (start + size > regionSize)
+    {
+        if (!overflowReported)
+            printf("Stream buffer region full, increase its size.\n");
+        overflowReported = true;
+        return false;
+    }
+
+    if (persistent)
+    {
+        offset = region * regionSize + start;
+        memcpy(mapped + offset, data, size);
+    }
+    else
+    {
+        offset = start;
+        memcpy(&staging[start], data, size);
+    }
+    regionOffset = start + size;
+
+    return true;
+}
+
+void StreamBuffer::flush()
+{
+    // Coherent mappings need no explicit flush
+    if (persistent || flushedOffset == regionOffset)
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, flushedOffset, regionOffset - flushedOffset, &staging[flushedOffset]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    flushedOffset = regionOffset;
+}
+
+void StreamBuffer::endFrame()
+{
+    flush();
+    if (persistent)
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+size_t StreamBuffer::bytesUsed()
+{
+    return regionOffset;
+}
+
+void StreamBuffer::deleteBuffers()
+{
+    for (unsigned int i = 0; i < framesInFlight; i++)
+        if (fences[i])
+            glDeleteSync(fences[i]);
+
+    if (persistent)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &buffer);
+}
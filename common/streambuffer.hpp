@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Per-draw uniform block (std140), bound to ObjectBlock at objectBlockBinding
+struct ObjectUniforms
+{
+    glm::mat4 MVP;
+    glm::mat4 MV;
+};
+
+// Uniform block binding points shared by the shaders
+const unsigned int objectBlockBinding = 0;
+const unsigned int lightBlockBinding = 1;
+const unsigned int shadowBlockBinding = 2;
+const unsigned int materialBlockBinding = 3;
+
+// Ring buffer for per-frame dynamic data. With ARB_buffer_storage the buffer
+// is persistently mapped and split into one region per frame in flight, each
+// guarded by a fence. On plain GL 3.3 writes are staged on the CPU and
+// uploaded into an orphaned buffer.
+class StreamBuffer
+{
+public:
+    static const unsigned int framesInFlight = 3;
+
+    // Offset recorded for data that did not fit, draws using it are skipped
+    static const size_t failedOffset = ~static_cast<size_t>(0);
+
+    unsigned int buffer;
+    size_t uniformAlignment;
+    bool persistent;
+
+    // Constructor, regionSize is the number of bytes available each frame
+    StreamBuffer(const size_t regionSize);
+
+    // Start a new frame, waits if the GPU is still reading the next region
+    void beginFrame();
+
+    // Copy data into the current region, returns false if the region is full
+    bool write(const void *data, const size_t size, const size_t alignment, size_t &offset);
+
+    // Make everything written since the last flush visible to the GPU
+    void flush();
+
+    // Fence the region used this frame
+    void endFrame();
+
+    // Bytes written this frame
+    size_t bytesUsed();
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    size_t regionSize;
+    unsigned int region = 0;
+    size_t regionOffset = 0;
+    size_t flushedOffset = 0;
+    unsigned char *mapped = NULL;
+    GLsync fences[framesInFlight] = { 0 };
+    std::vector<unsigned char> staging;
+    bool overflowReported = false;
+};
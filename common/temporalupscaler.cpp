@@ -0,0 +1,149 @@
+#include <stdio.h>
+
+#include <common/shader.hpp>
+#include <common/temporalupscaler.hpp>
+
+// Length of the jitter sequence, long enough to cover a pixel at half scale
+static const unsigned int jitterLength = 16;
+
+// Radical inverse of an index in a base
+static float halton(unsigned int index, const unsigned int base)
+{
+    float result = 0.0f, fraction = 1.0f;
+    while (index > 0)
+    {
+        fraction /= base;
+        result += fraction * (index % base);
+        index /= base;
+    }
+    return result;
+}
+
+static unsigned int createTarget(const GLenum internalFormat, const GLenum format, const GLenum type,
+                                 const GLenum filter, const int width, const int height)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+TemporalUpscaler::TemporalUpscaler(const int width, const int height)
+{
+    this->width = width;
+    this->height = height;
+
+    // Programs
+    resolveShaderID = LoadShaders("fullscreenVertexShader.glsl", "temporalResolveFragmentShader.glsl");
+    presentShaderID = LoadShaders("fullscreenVertexShader.glsl", "presentFragmentShader.glsl");
+
+    // History at output resolution
+    for (unsigned int i = 0; i < 2; i++)
+        historyTextures[i] = createTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_LINEAR, width, height);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenVertexArrays(1, &emptyVAO);
+
+    printf("Upscaler: %dx%d output, %d KB of history\n", width, height, width * height * 2 * 8 / 1024);
+}
+
+TargetDesc TemporalUpscaler::colourDesc() const
+{
+    return TargetDesc(width, height, TargetRGBA16F);
+}
+
+TargetDesc TemporalUpscaler::depthDesc() const
+{
+    return TargetDesc(width, height, TargetDepth24);
+}
+
+void TemporalUpscaler::addPasses(RenderGraph &graph, RenderTargetPool &pool, const unsigned int sceneColour,
+                                 const unsigned int sceneDepth, const unsigned int output, const int renderWidth,
+                                 const int renderHeight, const glm::mat4 &viewProjection, const glm::vec2 &jitter)
+{
+    // Resolve into the other history buffer, reading this one
+    unsigned int next = 1 - currentHistory;
+    unsigned int history = graph.import("history", historyTextures[currentHistory], false);
+    unsigned int nextHistory = graph.import("next history", historyTextures[next], true);
+    RenderTargetPool *targets = &pool;
+
+    unsigned int pass = graph.addPass("temporal resolve", [=]()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, targets->framebuffer(nextHistory));
+        glViewport(0, 0, width, height);
+        glDisable(GL_DEPTH_TEST);
+
+        glUseProgram(resolveShaderID);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, targets->texture(sceneColour));
+        glUniform1i(glGetUniformLocation(resolveShaderID, "sceneColour"), 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, targets->texture(sceneDepth));
+        glUniform1i(glGetUniformLocation(resolveShaderID, "sceneDepth"), 1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, targets->texture(history));
+        glUniform1i(glGetUniformLocation(resolveShaderID, "history"), 2);
+
+        glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+        glUniform2f(glGetUniformLocation(resolveShaderID, "renderSize"), static_cast<float>(renderWidth), static_cast<float>(renderHeight));
+        glUniform2f(glGetUniformLocation(resolveShaderID, "jitter"), jitter.x, jitter.y);
+        glUniformMatrix4fv(glGetUniformLocation(resolveShaderID, "inverseViewProjection"), 1, GL_FALSE, &inverseViewProjection[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(resolveShaderID, "previousViewProjection"), 1, GL_FALSE, &previousViewProjection[0][0]);
+        glUniform1i(glGetUniformLocation(resolveShaderID, "historyValid"), historyValid);
+        glUniform1f(glGetUniformLocation(resolveShaderID, "blendFactor"), blendFactor);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+
+        currentHistory = next;
+        previousViewProjection = viewProjection;
+        historyValid = true;
+    });
+    graph.read(pass, sceneColour);
+    graph.read(pass, sceneDepth);
+    graph.read(pass, history);
+    graph.write(pass, nextHistory);
+
+    // Copy the new history to the output
+    pass = graph.addPass("present", [=]()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, targets->framebuffer(output));
+        glViewport(0, 0, width, height);
+        glDisable(GL_DEPTH_TEST);
+        glUseProgram(presentShaderID);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, targets->texture(nextHistory));
+        glUniform1i(glGetUniformLocation(presentShaderID, "image"), 0);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    });
+    graph.read(pass, nextHistory);
+    graph.write(pass, output);
+}
+
+void TemporalUpscaler::reset()
+{
+    historyValid = false;
+}
+
+glm::vec2 TemporalUpscaler::jitter(const unsigned int frame)
+{
+    unsigned int index = frame % jitterLength + 1;
+    return glm::vec2(halton(index, 2) - 0.5f, halton(index, 3) - 0.5f);
+}
+
+void TemporalUpscaler::deleteBuffers()
+{
+    glDeleteTextures(2, historyTextures);
+    glDeleteVertexArrays(1, &emptyVAO);
+    glDeleteProgram(resolveShaderID);
+    glDeleteProgram(presentShaderID);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/rendergraph.hpp>
+#include <common/rendertargets.hpp>
+
+// Temporal upscaling. The scene is drawn with a sub-pixel jittered projection
+// into the bottom left corner of transient targets of the render graph, at whatever fraction of
+// the output size the frame is given. The resolve pass reprojects each output
+// pixel into last frame's history through the closest depth around it, clamps
+// the history to the colour range of the current neighbourhood to reject
+// disoccluded and changed surfaces, and blends in the current frame, so the
+// jittered samples of several frames accumulate into an output resolution
+// image. The history is at output resolution, so a change of scale blends in
+// over a few frames rather than popping.
+class TemporalUpscaler
+{
+public:
+    // Weight of the current frame in the history
+    float blendFactor = 0.1f;
+
+    // Constructor, the output and largest scene size
+    TemporalUpscaler(const int width, const int height);
+
+    // Scene targets, the scene is drawn into their bottom left renderWidth x renderHeight
+    // corner with a projection jittered by jitter()
+    TargetDesc colourDesc() const;
+    TargetDesc depthDesc() const;
+
+    // Add the passes accumulating the scene into the history and drawing the result to
+    // the output. The view projection is this frame's without the jitter, the jitter
+    // the sample offset in rendered pixels.
+    void addPasses(RenderGraph &graph, RenderTargetPool &pool, const unsigned int sceneColour,
+                   const unsigned int sceneDepth, const unsigned int output, const int renderWidth,
+                   const int renderHeight, const glm::mat4 &viewProjection, const glm::vec2 &jitter);
+
+    // Drop the history, the next resolve starts from the current frame
+    void reset();
+
+    // Sample offset in rendered pixels of a frame, from the Halton (2, 3) sequence
+    static glm::vec2 jitter(const unsigned int frame);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    int width, height;
+
+    // Programs
+    unsigned int resolveShaderID;
+    unsigned int presentShaderID;
+
+    // History buffers imported into the graph, each resolve reads one and writes the other
+    unsigned int historyTextures[2];
+    unsigned int currentHistory = 0;
+    bool historyValid = false;
+    glm::mat4 previousViewProjection;
+
+    unsigned int emptyVAO;
+};
@@ -0,0 +1,120 @@
+#include <common/transform.hpp>
+#include <common/maths.hpp>
+
+int TransformHierarchy::add(const glm::vec3 &position, const float angle, const glm::vec3 &axis,
+                            const glm::vec3 &scale, const int parent)
+{
+    Node node;
+    node.position = position;
+    node.axis = axis;
+    node.scale = scale;
+    node.angle = angle;
+    node.parent = parent;
+
+    int index = static_cast<int>(nodes.size());
+    if (parent != -1)
+    {
+        node.nextSibling = nodes[parent].firstChild;
+        nodes[parent].firstChild = index;
+    }
+    nodes.push_back(node);
+    locals.push_back(glm::mat4(1.0f));
+    worlds.push_back(glm::mat4(1.0f));
+    changedUpdate.push_back(0);
+    dirtyNodes.push_back(index);
+
+    return index;
+}
+
+void TransformHierarchy::setPosition(const int node, const glm::vec3 &position)
+{
+    nodes[node].position = position;
+    markDirty(node);
+}
+
+void TransformHierarchy::setRotation(const int node, const float angle, const glm::vec3 &axis)
+{
+    nodes[node].angle = angle;
+    nodes[node].axis = axis;
+    markDirty(node);
+}
+
+void TransformHierarchy::setScale(const int node, const glm::vec3 &scale)
+{
+    nodes[node].scale = scale;
+    markDirty(node);
+}
+
+void TransformHierarchy::markDirty(const int node)
+{
+    if (nodes[node].dirty)
+        return;
+    nodes[node].dirty = true;
+    dirtyNodes.push_back(node);
+}
+
+void TransformHierarchy::update()
+{
+    changedNodes.clear();
+    updateCount++;
+    for (unsigned int d = 0; d < dirtyNodes.size(); d++)
+    {
+        // Already rebuilt as part of a dirty ancestor's subtree
+        int top = dirtyNodes[d];
+        if (!nodes[top].dirty)
+            continue;
+
+        // Start from the highest dirty ancestor so each subtree is only walked once
+        for (int parent = nodes[top].parent; parent != -1; parent = nodes[parent].parent)
+            if (nodes[parent].dirty)
+                top = parent;
+
+        // Dirty nodes rebuild their local matrix, every node below them their world matrix
+        stack.push_back(top);
+        while (!stack.empty())
+        {
+            int node = stack.back();
+            stack.pop_back();
+
+            Node &n = nodes[node];
+            if (n.dirty)
+            {
+                locals[node] = Maths::transform(n.position, n.angle, n.axis, n.scale);
+                n.dirty = false;
+            }
+            worlds[node] = n.parent == -1 ? locals[node] : worlds[n.parent] * locals[node];
+            changedNodes.push_back(node);
+            changedUpdate[node] = updateCount;
+
+            for (int child = n.firstChild; child != -1; child = nodes[child].nextSibling)
+                stack.push_back(child);
+        }
+    }
+    dirtyNodes.clear();
+    numUpdated = static_cast<unsigned int>(changedNodes.size());
+}
+
+const glm::mat4 &TransformHierarchy::local(const int node)
+{
+    return locals[node];
+}
+
+const glm::mat4 &TransformHierarchy::world(const int node)
+{
+    return worlds[node];
+}
+
+const std::vector<int> &TransformHierarchy::changed()
+{
+    return changedNodes;
+}
+
+bool TransformHierarchy::wasChanged(const int node)
+{
+    return changedUpdate[node] == updateCount;
+}
+
+unsigned int TransformHierarchy::size()
+{
+    return static_cast<unsigned int>(nodes.size());
+}
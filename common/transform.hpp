@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Parent/child hierarchy of transforms with cached local and world matrices.
+// Changing a transform marks it dirty and update() only rebuilds the matrices
+// of dirty subtrees, so parts of the scene that never change cost nothing.
+class TransformHierarchy
+{
+public:
+    // World matrices rebuilt by the last update
+    unsigned int numUpdated = 0;
+
+    // Add a transform, parents must be added before their children
+    int add(const glm::vec3 &position, const float angle, const glm::vec3 &axis,
+            const glm::vec3 &scale, const int parent = -1);
+
+    // Change the local transform
+    void setPosition(const int node, const glm::vec3 &position);
+    void setRotation(const int node, const float angle, const glm::vec3 &axis);
+    void setScale(const int node, const glm::vec3 &scale);
+
+    // Rebuild the matrices of the dirty subtrees
+    void update();
+
+    // Cached matrices, valid after update
+    const glm::mat4 &local(const int node);
+    const glm::mat4 &world(const int node);
+
+    // Transforms whose world matrix changed in the last update
+    const std::vector<int> &changed();
+    bool wasChanged(const int node);
+
+    // Number of transforms
+    unsigned int size();
+
+private:
+    struct Node
+    {
+        glm::vec3 position;
+        glm::vec3 axis;
+        glm::vec3 scale;
+        float angle;
+        int parent;
+        int firstChild = -1;
+        int nextSibling = -1;
+        bool dirty = true;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<int> dirtyNodes;
+    std::vector<int> changedNodes;
+    std::vector<int> stack;
+    std::vector<unsigned int> changedUpdate;
+    unsigned int updateCount = 0;
+
+    void markDirty(const int node);
+};
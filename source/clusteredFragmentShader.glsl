@@ -0,0 +1,83 @@
+#version 330 core
+
+// Inputs
+in vec2 UV;
+in mat3 TBN;
+
+// Outputs
+out vec3 fragmentColour;
+
+// Material uniforms
+uniform sampler2D diffuseMap;
+uniform sampler2D normalMap;
+uniform sampler2D specularMap;
+uniform float ka;
+uniform float kd;
+uniform float ks;
+uniform float Ns;
+
+// Light clusters, each light is four texels:
+//   position, constant | colour, linear | direction, quadratic | cosPhi, type
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer lightIndices;
+uniform int numGlobalLights;
+uniform mat4 inverseP;
+uniform vec2 screenSize;
+uniform vec2 tileSize;
+uniform ivec3 gridSize;
+uniform float near;
+uniform float sliceScale;
+
+// Same lighting model as the forward shader, in view space
+vec3 shade(int light, vec3 fragmentPosition, vec3 normal, vec3 objectColour, float specularMapValue)
+{
+    vec4 positionConstant  = texelFetch(lightData, 4 * light);
+    vec4 colourLinear      = texelFetch(lightData, 4 * light + 1);
+    vec4 directionQuadratic = texelFetch(lightData, 4 * light + 2);
+    vec4 cone              = texelFetch(lightData, 4 * light + 3);
+    int type               = int(cone.y);
+    vec3 lightColour       = colourLinear.rgb;
+
+    vec3 light = type == 3 ? normalize(-directionQuadratic.xyz) : normalize(positionConstant.xyz - fragmentPosition);
+    vec3 ambient    = ka * objectColour;
+    float cosTheta  = max(dot(normal, light), 0);
+    vec3 diffuse    = kd * lightColour * objectColour * cosTheta;
+    vec3 reflection = - light + 2 * dot(light, normal) * normal;
+    vec3 camera     = normalize(-fragmentPosition);
+    float cosAlpha  = max(dot(camera, reflection), 0);
+    vec3 specular   = ks * lightColour * pow(cosAlpha, Ns) * specularMapValue;
+    vec3 colour     = ambient + diffuse + specular;
+
+    if (type != 3)
+    {
+        float distance = length(positionConstant.xyz - fragmentPosition);
+        colour /= positionConstant.w + colourLinear.w * distance + directionQuadratic.w * distance * distance;
+    }
+    if (type == 2)
+        colour *= clamp((dot(-light, normalize(directionQuadratic.xyz)) - cone.x) / radians(2.0), 0.0, 1.0);
+    return colour;
+}
+
+void main()
+{
+    // View space position from the window position and depth
+    vec4 position = inverseP * vec4(2.0 * vec3(gl_FragCoord.xy / screenSize, gl_FragCoord.z) - 1.0, 1.0);
+    vec3 fragmentPosition = position.xyz / position.w;
+
+    vec3 normal = normalize(TBN * normalize(2.0 * vec3(texture(normalMap, UV)) - 1.0));
+    vec3 objectColour = vec3(texture(diffuseMap, UV));
+    float specularMapValue = texture(specularMap, UV).r;
+
+    fragmentColour = vec3(0.0);
+    for (int i = 0; i < numGlobalLights; i++)
+        fragmentColour += shade(i, fragmentPosition, normal, objectColour, specularMapValue);
+
+    // Cluster of this fragment
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / tileSize), gridSize.xy - 1);
+    int slice = clamp(int(log(-fragmentPosition.z / near) * sliceScale), 0, gridSize.z - 1);
+    int cluster = (slice * gridSize.y + tile.y) * gridSize.x + tile.x;
+    uvec2 range = texelFetch(clusterRanges, cluster).xy;
+    for (uint i = 0u; i < range.y; i++)
+        fragmentColour += shade(int(texelFetch(lightIndices, int(range.x + i)).r), fragmentPosition, normal, objectColour, specularMapValue);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+// Inputs
+in vec2 UV;
+
+// Outputs
+out vec3 fragmentColour;
+
+// Uniforms
+uniform sampler2D lightMap;
+uniform sampler2D depthMap;
+
+void main()
+{
+    // Background keeps the framebuffer's clear colour
+    float depth = texture(depthMap, UV).r;
+    if (depth == 1.0)
+        discard;
+
+    fragmentColour = texture(lightMap, UV).rgb;
+    gl_FragDepth = depth;
+}
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include <thread>
+#include <chrono>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -11,24 +13,146 @@
 #include <common/camera.hpp>
 #include <common/model.hpp>
 #include <common/light.hpp>
+#include <common/geometrypool.hpp>
+#include <common/renderqueue.hpp>
+#include <common/staticbatch.hpp>
+#include <common/streambuffer.hpp>
+#include <common/culling.hpp>
+#include <common/bvh.hpp>
+#include <common/occlusion.hpp>
+#include <common/gpuculling.hpp>
+#include <common/pvs.hpp>
+#include <common/transform.hpp>
+#include <common/entity.hpp>
+#include <common/jobsystem.hpp>
+#include <common/drawlist.hpp>
+#include <common/framehandoff.hpp>
+#include <common/deferred.hpp>
+#include <common/clusteredlighting.hpp>
+#include <common/lightselection.hpp>
+#include <common/shadowatlas.hpp>
+#include <common/shadowmaps.hpp>
+#include <common/materials.hpp>
+#include <common/dynamicresolution.hpp>
+#include <common/temporalupscaler.hpp>
+#include <common/antialiasing.hpp>
+#include <common/rendergraph.hpp>
+#include <common/rendertargets.hpp>
+#include <algorithm>
 
 // Function prototypes
 void keyboardInput(GLFWwindow* window);
 void mouseInput(GLFWwindow* window);
+bool keyPressed(GLFWwindow* window, int key);
 
 // Frame timers
 float previousTime = 0.0f;
 float deltaTime = 0.0f;
+float statsTime = 0.0f;
+unsigned int frameCount = 0;
+
+// Render options
+bool useInstancing = true;
+bool useGeometryPool = false;
+bool useStaticBatching = true;
+bool useFrustumCulling = true;
+bool useBVHCulling = false;
+bool useOcclusionCulling = true;
+bool useGPUCulling = false;
+bool usePVS = true;
+bool overlapRendering = true;
+bool useDepthPrepass = false;
+bool useDeferredShading = false;
+bool useClusteredShading = false;
+bool useLightSelection = true;
+bool useViewSpaceLighting = true;
+bool useShadows = true;
+bool useDynamicResolution = true;
+AntiAliasingMode antiAliasingMode = AAMSAA4;
+
+// Objects projecting to fewer pixels than this are culled
+const float minScreenSize = 1.0f;
+
+// Number of largest occluders rasterized for occlusion culling
+const unsigned int maxOccluders = 32;
+
+// GPU time per frame the dynamic resolution aims for
+const float gpuBudgetMilliseconds = 8.0f;
 
 Camera camera(glm::vec3(0.0f, 5.0f, 15.0f), glm::vec3(0.0f, 0.0f, 0.0f));
 
-struct Object
+// Model and geometry pool mesh of each batch, entity mesh IDs index the batches
+struct InstanceBatch
+{
+    Model *model;
+    int meshID;
+};
+
+// A dynamic object drawn into a shadow tile
+struct ShadowCaster
+{
+    unsigned int tile;
+    int mesh;
+    glm::mat4 MVP;
+};
+
+// Figures the render thread reports for a packet once it has drawn it
+struct FrameStats
+{
+    float submitMilliseconds = 0.0f;
+    unsigned int bytesStreamed = 0;
+    unsigned int gpuVisible = 0, gpuInstances = 0;
+    unsigned int chunkDraws = 0;
+    unsigned int shadedSamples = 0;
+    unsigned int lightVolumes = 0;
+    unsigned int lightBlocks = 0;
+    unsigned int shadowDraws = 0;
+    float gpuMilliseconds = 0.0f;
+    float gpuScale = 1.0f;
+    float antiAliasingMilliseconds = 0.0f;
+    unsigned int graphPasses = 0, graphCulled = 0;
+    unsigned int transientBytes = 0, aliasedBytes = 0, pooledBytes = 0;
+};
+
+// Everything the render thread needs to draw a frame, filled by the main thread
+struct FramePacket
 {
-    glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
-    glm::vec3 rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    float angle = 0.0f;
-    std::string name;
+    // Camera and the options the frame was prepared with
+    glm::mat4 view, projection;
+    float near, far;
+    bool gpuCulling, staticBatching, geometryPool, instancing, depthPrepass, deferred, clustered, lightSelection, viewSpaceLighting, shadows;
+
+    // With temporal upscaling the projection is jittered and the scene drawn at the
+    // render size, the resolve reprojects with the unjittered view projection
+    bool upscaling;
+    AntiAliasingMode antiAliasing;
+    int renderWidth, renderHeight;
+    glm::vec2 jitter;
+    glm::mat4 viewProjection;
+
+    // World space lights, the scene's first, and for clustered shading their froxel
+    // assignment, for forward per-object draws the lights selected for each draw
+    std::vector<LightSource> lights;
+    unsigned int numSceneLights = 0;
+    LightClusters clusters;
+    LightSelection selection;
+
+    // Shadow tiles, the tiles whose static depth is refreshed with the chunks they
+    // see, and the dynamic objects drawn over the tiles
+    std::vector<ShadowTile> shadowTiles;
+    float cascadeSplits[numCascades];
+    std::vector<unsigned int> shadowRefresh;
+    std::vector<std::vector<unsigned int> > shadowChunks;
+    std::vector<ShadowCaster> shadowCasters;
+
+    // Visible static chunks, visible instance matrices of each batch and the per-object draws
+    std::vector<unsigned int> visibleChunks;
+    std::vector<std::vector<glm::mat4> > instances;
+    std::vector<std::vector<int> > instanceMaterials;
+    DrawList drawList;
+
+    // Written by the render thread once it has drawn the packet
+    FrameStats stats;
 };
 
 int main(void)
@@ -41,7 +165,8 @@ int main(void)
         return -1;
     }
 
-    glfwWindowHint(GLFW_SAMPLES, 4);
+    // Single sampled, anti-aliasing draws the scene offscreen and resolves into it
+    glfwWindowHint(GLFW_SAMPLES, 0);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -75,6 +200,46 @@ int main(void)
     // Shaders
     unsigned int shaderID = LoadShaders("vertexShader.glsl", "fragmentShader.glsl");
     glUseProgram(shaderID);
+    glUniformBlockBinding(shaderID, glGetUniformBlockIndex(shaderID, "ObjectBlock"), objectBlockBinding);
+    glUniformBlockBinding(shaderID, glGetUniformBlockIndex(shaderID, "LightBlock"), lightBlockBinding);
+
+    // Forward shader lighting in view space, it only interpolates the normal and tangent
+    // instead of every light's tangent space position and direction
+    unsigned int viewSpaceShaderID = LoadShaders("viewSpaceVertexShader.glsl", "viewSpaceFragmentShader.glsl");
+    glUniformBlockBinding(viewSpaceShaderID, glGetUniformBlockIndex(viewSpaceShaderID, "ObjectBlock"), objectBlockBinding);
+    glUniformBlockBinding(viewSpaceShaderID, glGetUniformBlockIndex(viewSpaceShaderID, "LightBlock"), lightBlockBinding);
+    glUniformBlockBinding(viewSpaceShaderID, glGetUniformBlockIndex(viewSpaceShaderID, "ShadowBlock"), shadowBlockBinding);
+    glUniformBlockBinding(viewSpaceShaderID, glGetUniformBlockIndex(viewSpaceShaderID, "MaterialBlock"), materialBlockBinding);
+
+    // Depth-only shader for the pre-pass
+    unsigned int depthShaderID = LoadShaders("depthVertexShader.glsl", "depthFragmentShader.glsl");
+    glUniformBlockBinding(depthShaderID, glGetUniformBlockIndex(depthShaderID, "ObjectBlock"), objectBlockBinding);
+
+    // G-buffer and light volumes for deferred shading
+    DeferredRenderer deferred(1024, 768, "../assets/sphere.obj");
+
+    // Texture buffers and program for clustered forward shading
+    ClusteredLighting clustered(1024, 768);
+
+    // Shadow atlas tiles of the shadow casting lights, planned on the main thread
+    // and rendered on the render thread
+    ShadowAtlas shadowAtlas;
+    ShadowMaps shadowMaps(shadowAtlas);
+
+    // History for temporal upscaling, the render size is chosen on the main thread
+    // from the GPU times the render thread measures
+    TemporalUpscaler upscaler(1024, 768);
+    DynamicResolution resolution(gpuBudgetMilliseconds);
+
+    // Anti-aliasing of the frames that are not upscaled
+    AntiAliasing antiAliasing(1024, 768);
+
+    // Frame graph rebuilt by the render thread each frame, and the textures behind its targets
+    RenderGraph graph;
+    RenderTargetPool pool;
+
+    // Ring buffer for all per-frame dynamic data
+    StreamBuffer streamBuffer(8 * 1024 * 1024);
 
     // Models and textures
     Model cube("../assets/cube.obj");
@@ -84,82 +249,965 @@ int main(void)
     cube.ks = 0.5f;
     cube.Ns = 20.0f;
 
-
+    // Material table read by the view space shader, entity materials index it.
+    // The crates vary the crate texture so differently finished crates still share draws.
+    MaterialTable materialTable;
+    int crateLayer = materialTable.addLayer("../assets/crate.jpg");
+    const int plainCrate = materialTable.addMaterial(crateLayer, -1, -1, cube.ka, cube.kd, cube.ks, cube.Ns);
+    materialTable.addMaterial(crateLayer, -1, -1, 0.8f, 0.6f, 0.2f, 8.0f, glm::vec3(0.75f, 0.8f, 0.85f));
+    materialTable.addMaterial(crateLayer, -1, -1, 1.0f, 0.5f, 0.7f, 40.0f, glm::vec3(1.0f, 0.55f, 0.45f));
+    materialTable.addMaterial(crateLayer, -1, -1, 0.9f, 0.5f, 0.3f, 12.0f, glm::vec3(0.6f, 0.85f, 0.55f));
+    const int numCrateMaterials = 4;
+    materialTable.build();
 
     // Light setup
     Light lightSources;
     lightSources.addDirectionalLight(glm::vec3(1.0f, -1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f));
+    lightSources.addSpotLight(glm::vec3(-10.0f, 8.0f, 6.0f), glm::vec3(0.3f, -1.0f, -0.6f), glm::vec3(1.0f, 0.9f, 0.7f),
+                              1.0f, 0.05f, 0.01f, cosf(Maths::radians(25.0f)));
+    lightSources.addPointLight(glm::vec3(12.0f, 3.0f, 3.0f), glm::vec3(0.8f, 0.6f, 0.3f), 1.0f, 0.09f, 0.032f);
+    for (unsigned int l = 0; l < lightSources.lightSources.size(); l++)
+        lightSources.lightSources[l].castShadows = true;
+
+    // Small coloured point lights circling over the floor, only the deferred and clustered
+    // paths and forward draws with per-object light selection can afford them
+    Light dynamicLights;
+    std::vector<glm::vec3> lightCentres;
+    const int lightGrid = 32;
+    for (int x = 0; x < lightGrid; x++)
+        for (int z = 0; z < lightGrid; z++)
+        {
+            glm::vec3 centre(-45.0f + 90.0f * x / (lightGrid - 1), 0.5f, -22.0f + 44.0f * z / (lightGrid - 1));
+            glm::vec3 colour(0.5f + 0.5f * sinf(1.7f * x), 0.5f + 0.5f * sinf(2.3f * z + 1.0f), 0.5f + 0.5f * sinf(1.3f * (x + z) + 2.0f));
+            dynamicLights.addPointLight(centre, 0.6f * colour, 1.0f, 1.4f, 3.6f);
+            lightCentres.push_back(centre);
+        }
+
+
+    // Worker threads shared by baking and culling
+    JobSystem jobs;
+    printf("Job system: %u threads\n", jobs.size());
 
+    // Shared geometry pool holding every mesh
+    GeometryPool geometryPool(65536, 262144);
 
-    // Create 20 pillars of stacked crates
-    std::vector<Object> objects;
+    // Instance batches for each model used by the entities
+    std::vector<InstanceBatch> batches;
+    InstanceBatch cubeBatch;
+    cubeBatch.model = &cube;
+    cubeBatch.meshID = geometryPool.addModel(cube);
+    batches.push_back(cubeBatch);
+    const int cubeMesh = 0;
+
+    // Create 20 pillars of stacked crates, each crate is a child of its pillar's transform
+    TransformHierarchy transforms;
+    EntityStore entities;
     const int numPillars = 20;
     const int cratesPerPillar = 5;
     const float pillarSpacing = 5.0f;
     const float startX = -((numPillars - 1) * pillarSpacing) / 2.0f;
 
     for (int pillar = 0; pillar < numPillars; pillar++) {
+        glm::vec3 pillarPosition(startX + pillar * pillarSpacing, 0.0f, 0.0f);
+        int pillarTransform = transforms.add(pillarPosition, 0.0f, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f));
         for (int level = 0; level < cratesPerPillar; level++) {
-            Object crate;
-            crate.name = "cube";
-            crate.position = glm::vec3(startX + pillar * pillarSpacing, level * 1.0f, 0.0f);
-            crate.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-            crate.angle = Maths::radians(0.0f);
-            crate.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-            objects.push_back(crate);
+            entities.create(glm::vec3(0.0f, level * 1.0f, 0.0f), Maths::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                            glm::vec3(1.0f, 1.0f, 1.0f), cubeMesh, plainCrate + (pillar + level) % numCrateMaterials, cube.bounds,
+                            EntityStatic | EntityOccluder, pillarTransform);
         }
     }
 
     // Add a floor
-    Object floor;
-    floor.name = "cube";
-    floor.position = glm::vec3(0.0f, -0.5f, 0.0f);
-    floor.scale = glm::vec3(50.0f, 0.1f, 50.0f);
-    floor.angle = 0.0f;
-    objects.push_back(floor);
-
-    // Render loop
+    entities.create(glm::vec3(0.0f, -0.5f, 0.0f), 0.0f, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(50.0f, 0.1f, 50.0f),
+                    cubeMesh, plainCrate, cube.bounds, EntityStatic);
+
+    transforms.update();
+    std::vector<unsigned int> changedEntities;
+
+    // Only these are drawn into the shadow tiles each frame, the rest is cached
+    std::vector<unsigned int> dynamicEntities, visibleCasters;
+    for (unsigned int i = 0; i < entities.size(); i++)
+        if (!(entities.flags[i] & EntityStatic))
+            dynamicEntities.push_back(i);
+    entities.updateTransforms(transforms, changedEntities);
+
+    // Merge the static objects into spatial chunks
+    StaticBatch staticBatch(10.0f);
+    for (unsigned int i = 0; i < entities.size(); i++)
+        if (entities.flags[i] & EntityStatic)
+            staticBatch.add(batches[entities.meshes[i]].model, entities.worlds[i], entities.materials[i]);
+    staticBatch.build();
+
+    // The entities' world bounds are culled directly, the hierarchy keeps
+    // the proxies so that moved entities can be updated
+    BVH objectTree;
+    std::vector<int> objectProxies;
+    for (unsigned int i = 0; i < entities.size(); i++)
+        objectProxies.push_back(objectTree.insert(entities.bounds.box(i), i));
+    objectTree.rebuild();
+
+    BoundsArray chunkBounds;
+    for (unsigned int i = 0; i < staticBatch.chunks.size(); i++)
+    {
+        AABB box;
+        box.min = staticBatch.chunks[i].boundsMin;
+        box.max = staticBatch.chunks[i].boundsMax;
+        chunkBounds.add(box);
+    }
+
+    // Potentially visible sets of the objects and chunks over the walkable space,
+    // loaded from the last bake unless the layout has changed
+    AABB walkable;
+    walkable.min = glm::vec3(startX - 5.0f, 0.0f, -25.0f);
+    walkable.max = glm::vec3(-startX + 5.0f, 6.0f, 25.0f);
+    const float pvsCellSize = 2.5f;
+    std::vector<AABB> objectBoxes, chunkBoxes;
+    for (unsigned int i = 0; i < entities.bounds.size(); i++)
+        objectBoxes.push_back(entities.bounds.box(i));
+    for (unsigned int i = 0; i < chunkBounds.size(); i++)
+        chunkBoxes.push_back(chunkBounds.box(i));
+
+    PVS objectPVS, chunkPVS;
+    objectPVS.jobs = &jobs;
+    chunkPVS.jobs = &jobs;
+    if (!objectPVS.load("objects.pvs", walkable, pvsCellSize, objectBoxes, objectBoxes))
+    {
+        objectPVS.bake(walkable, pvsCellSize, objectBoxes, objectBoxes);
+        objectPVS.save("objects.pvs");
+        printf("Baked object PVS in %.0f ms\n", objectPVS.bakeMilliseconds);
+    }
+    if (!chunkPVS.load("chunks.pvs", walkable, pvsCellSize, objectBoxes, chunkBoxes))
+    {
+        chunkPVS.bake(walkable, pvsCellSize, objectBoxes, chunkBoxes);
+        chunkPVS.save("chunks.pvs");
+        printf("Baked chunk PVS in %.0f ms\n", chunkPVS.bakeMilliseconds);
+    }
+    printf("PVS: %u cells, %u + %u sets, %u KB\n", objectPVS.numCells, objectPVS.numSets, chunkPVS.numSets,
+           static_cast<unsigned int>((objectPVS.compressedBytes + chunkPVS.compressedBytes) / 1024));
+
+    std::vector<unsigned int> visibleObjects;
+    visibleObjects.reserve(entities.size());
+
+    // Software occlusion culling against the largest visible occluders
+    OcclusionCuller occlusionCuller(256, 192);
+    occlusionCuller.jobs = &jobs;
+    std::vector<std::pair<float, unsigned int> > occluderCandidates;
+    occluderCandidates.reserve(entities.size());
+
+    // GPU culling of every object, the instances never change so they are uploaded once
+    GPUCuller gpuCuller(1024, 768, entities.size());
+    gpuCuller.setInstances(entities.worlds, objectBoxes);
+
+    static_assert(sizeof(DrawData) == sizeof(ObjectUniforms), "DrawData must match the object uniform block");
+
+    // Frame packets double-buffered between the main thread, which prepares
+    // frame N + 1, and the render thread, which owns the GL context and draws frame N
+    FramePacket packets[2];
+    for (int p = 0; p < 2; p++)
+    {
+        packets[p].instances.resize(batches.size());
+        packets[p].instanceMaterials.resize(batches.size());
+        packets[p].visibleChunks.reserve(staticBatch.chunks.size());
+        packets[p].drawList.jobs = &jobs;
+        packets[p].clusters.jobs = &jobs;
+        packets[p].selection.jobs = &jobs;
+    }
+    FrameHandoff handoff;
+
+    // From here on only the render thread makes GL calls
+    glfwMakeContextCurrent(NULL);
+    std::thread renderThread([&]()
+    {
+        glfwMakeContextCurrent(window);
+        Light frameLights;
+        std::vector<size_t> objectOffsets(entities.size());
+        std::vector<size_t> lightOffsets(entities.size());
+        std::vector<size_t> casterOffsets;
+        std::vector<size_t> instanceOffsets(batches.size());
+        std::vector<size_t> materialOffsets(batches.size());
+        std::vector<unsigned int> instanceCounts(batches.size(), 0);
+
+        // Samples passed queries of the lighting pass, in flight over several frames
+        const unsigned int numSampleQueries = 3;
+        unsigned int sampleQueries[numSampleQueries];
+        glGenQueries(numSampleQueries, sampleQueries);
+        unsigned int queryFrame = 0;
+        unsigned int shadedSamples = 0;
+
+        // GPU time of each frame and the scale it was drawn at, read back like the samples
+        unsigned int timeQueries[numSampleQueries];
+        float timeScales[numSampleQueries];
+        glGenQueries(numSampleQueries, timeQueries);
+        float gpuMilliseconds = 0.0f, gpuScale = 1.0f;
+        int index;
+        while ((index = handoff.beginRead()) >= 0)
+        {
+            FramePacket &packet = packets[index];
+            unsigned int &forwardShaderID = packet.viewSpaceLighting ? viewSpaceShaderID : shaderID;
+            auto start = std::chrono::high_resolution_clock::now();
+
+            glBeginQuery(GL_TIME_ELAPSED, timeQueries[queryFrame % numSampleQueries]);
+            timeScales[queryFrame % numSampleQueries] = packet.upscaling ? static_cast<float>(packet.renderWidth) / 1024.0f : 1.0f;
+            glUseProgram(forwardShaderID);
+
+            streamBuffer.beginFrame();
+            frameLights.lightSources.assign(packet.lights.begin(), packet.lights.begin() + packet.numSceneLights);
+            frameLights.toShader(streamBuffer, packet.view);
+
+            // The frame's passes are declared with the targets they read and write, then
+            // culled, ordered and given textures before any of them runs
+            graph.reset();
+            unsigned int backbuffer = graph.import("backbuffer", 0, true);
+
+            // The atlases belong to the shadow maps, the graph only orders the pass writing them.
+            // Nothing reads the atlas with shadows off, so the pass is culled.
+            unsigned int shadowAtlasTarget = graph.import("shadow atlas", 0, false);
+            packet.stats.shadowDraws = 0;
+            unsigned int shadowPass = graph.addPass("shadows", [&]()
+            {
+                // Refresh the cached static depth of this frame's tiles
+                glUseProgram(depthShaderID);
+                glUniform1i(glGetUniformLocation(depthShaderID, "instanced"), 0);
+                for (unsigned int r = 0; r < packet.shadowRefresh.size(); r++)
+                {
+                    const ShadowTile &tile = packet.shadowTiles[packet.shadowRefresh[r]];
+                    shadowMaps.beginTile(packet.shadowRefresh[r], tile, false);
+                    staticBatch.drawDepth(depthShaderID, streamBuffer, packet.shadowChunks[r], tile.view, tile.projection);
+                    packet.stats.shadowDraws += static_cast<unsigned int>(packet.shadowChunks[r].size());
+                }
+
+                // Redraw the dynamic objects over the tiles they fall in
+                shadowMaps.clearDynamic(packet.shadowTiles);
+                casterOffsets.resize(packet.shadowCasters.size());
+                for (unsigned int c = 0; c < packet.shadowCasters.size(); c++)
+                {
+                    ObjectUniforms uniforms;
+                    uniforms.MVP = packet.shadowCasters[c].MVP;
+                    uniforms.MV = packet.shadowCasters[c].MVP;
+                    if (!streamBuffer.write(&uniforms, sizeof(uniforms), streamBuffer.uniformAlignment, casterOffsets[c]))
+                        casterOffsets[c] = StreamBuffer::failedOffset;
+                }
+                streamBuffer.flush();
+                int currentTile = -1;
+                for (unsigned int c = 0; c < packet.shadowCasters.size(); c++)
+                {
+                    const ShadowCaster &caster = packet.shadowCasters[c];
+                    if (static_cast<int>(caster.tile) != currentTile)
+                    {
+                        shadowMaps.beginTile(caster.tile, packet.shadowTiles[caster.tile], true);
+                        currentTile = caster.tile;
+                    }
+                    if (casterOffsets[c] == StreamBuffer::failedOffset)
+                        continue;
+                    glBindBufferRange(GL_UNIFORM_BUFFER, objectBlockBinding, streamBuffer.buffer, casterOffsets[c], sizeof(ObjectUniforms));
+                    batches[caster.mesh].model->drawMesh();
+                }
+                packet.stats.shadowDraws += static_cast<unsigned int>(packet.shadowCasters.size());
+                shadowMaps.end(1024, 768);
+            });
+            graph.write(shadowPass, shadowAtlasTarget);
+
+            // The scene goes to the upscaler's targets at the frame's render size, otherwise
+            // to the anti-aliasing mode's targets or straight to the default framebuffer
+            unsigned int sceneColour = backbuffer, sceneDepth = backbuffer;
+            if (packet.upscaling)
+            {
+                sceneColour = graph.create("scene colour", upscaler.colourDesc());
+                sceneDepth = graph.create("scene depth", upscaler.depthDesc());
+            }
+            else
+            {
+                upscaler.reset();
+                if (packet.antiAliasing != AAOff)
+                {
+                    TargetDesc desc = antiAliasing.sceneDesc(packet.antiAliasing);
+                    sceneColour = graph.create("scene colour", desc);
+                    desc.format = TargetDepth24;
+                    sceneDepth = graph.create("scene depth", desc);
+                }
+            }
+
+            // Always bound so the shadow samplers never share a unit with the material textures
+            shadowMaps.bind(viewSpaceShaderID, streamBuffer, packet.shadowTiles, packet.cascadeSplits, packet.view);
+
+            // Draws without per-instance or per-vertex materials read the attribute's current value
+            materialTable.bind(viewSpaceShaderID);
+            glVertexAttribI1i(materialAttribute, plainCrate);
+            glUseProgram(forwardShaderID);
+            glUniformMatrix4fv(glGetUniformLocation(forwardShaderID, "V"), 1, GL_FALSE, &packet.view[0][0]);
+
+            if (packet.gpuCulling)
+            {
+                gpuCuller.cull(packet.projection * packet.view);
+                glUseProgram(forwardShaderID);
+            }
+
+            // Stream the instance matrices or every draw's matrices once, both passes read them
+            RenderQueue &renderQueue = packet.drawList.queue;
+            unsigned int numOpaque = 0;
+            if (!packet.gpuCulling && !packet.geometryPool && packet.instancing)
+            {
+                for (unsigned int b = 0; b < batches.size(); b++)
+                {
+                    instanceCounts[b] = static_cast<unsigned int>(packet.instances[b].size());
+                    if (instanceCounts[b] > 0 && !streamBuffer.write(&packet.instances[b][0], instanceCounts[b] * sizeof(glm::mat4), sizeof(glm::vec4), instanceOffsets[b]))
+                        instanceCounts[b] = 0;
+                    if (instanceCounts[b] > 0 && !streamBuffer.write(&packet.instanceMaterials[b][0], instanceCounts[b] * sizeof(int), sizeof(int), materialOffsets[b]))
+                        instanceCounts[b] = 0;
+                }
+            }
+            else if (!packet.gpuCulling && !packet.geometryPool)
+            {
+                for (unsigned int k = 0; k < renderQueue.items.size(); k++)
+                {
+                    const DrawData &draw = packet.drawList.draws[renderQueue.items[k].index];
+                    if (!streamBuffer.write(&draw, sizeof(ObjectUniforms), streamBuffer.uniformAlignment, objectOffsets[k]))
+                        objectOffsets[k] = StreamBuffer::failedOffset;
+                    if (RenderQueue::pass(renderQueue.items[k].key) == PassOpaque)
+                        numOpaque = k + 1;
+                }
+            }
+            packet.stats.lightBlocks = 0;
+            if (packet.lightSelection)
+            {
+                // Gather each draw's selected lights into its own light block, neighbouring
+                // draws reaching the same lights share one
+                const LightSelection &selection = packet.selection;
+                const unsigned int *previous = NULL;
+                unsigned int previousCount = 0;
+                for (unsigned int k = 0; k < renderQueue.items.size(); k++)
+                {
+                    unsigned int d = renderQueue.items[k].index;
+                    const unsigned int *selected = &selection.indices[d * maxLights];
+                    unsigned int count = selection.counts[d];
+                    if (previous && count == previousCount && std::equal(selected, selected + count, previous))
+                    {
+                        lightOffsets[k] = lightOffsets[k - 1];
+                        continue;
+                    }
+
+                    LightUniforms block[maxLights] = {};
+                    for (unsigned int l = 0; l < count; l++)
+                        block[l] = Light::toUniforms(packet.lights[selected[l]], packet.view);
+                    if (!streamBuffer.write(block, sizeof(block), streamBuffer.uniformAlignment, lightOffsets[k]))
+                        lightOffsets[k] = StreamBuffer::failedOffset;
+                    previous = selected;
+                    previousCount = count;
+                    packet.stats.lightBlocks++;
+                }
+            }
+            streamBuffer.flush();
+
+            // Draws whose uniforms did not fit in the stream buffer are skipped rather than
+            // reading another frame's data
+            auto written = [&](const unsigned int k, const bool lit)
+            {
+                return objectOffsets[k] != StreamBuffer::failedOffset &&
+                       !(lit && packet.lightSelection && lightOffsets[k] == StreamBuffer::failedOffset);
+            };
+
+            // Opaque geometry of every path except the geometry pool, depth-only passes bind no materials
+            auto drawOpaque = [&](unsigned int &program, const bool depthOnly)
+            {
+                if (packet.staticBatching && !packet.gpuCulling)
+                {
+                    if (depthOnly)
+                        staticBatch.drawDepth(program, streamBuffer, packet.visibleChunks, packet.view, packet.projection);
+                    else
+                        staticBatch.draw(program, streamBuffer, packet.visibleChunks, packet.view, packet.projection);
+                }
+
+                if (packet.gpuCulling)
+                {
+                    // Every object is a cube, drawn from the compacted visible instances
+                    glUniform1i(glGetUniformLocation(program, "instanced"), 1);
+                    glUniformMatrix4fv(glGetUniformLocation(program, "P"), 1, GL_FALSE, &packet.projection[0][0]);
+                    gpuCuller.draw(program, cube);
+                }
+                else if (packet.geometryPool)
+                    return;
+                else if (packet.instancing)
+                {
+                    // One instanced draw per model
+                    glUniform1i(glGetUniformLocation(program, "instanced"), 1);
+                    glUniformMatrix4fv(glGetUniformLocation(program, "P"), 1, GL_FALSE, &packet.projection[0][0]);
+                    for (unsigned int b = 0; b < batches.size(); b++)
+                        batches[b].model->drawInstanced(program, streamBuffer.buffer, instanceOffsets[b], instanceCounts[b], materialOffsets[b]);
+                }
+                else
+                {
+                    // Submit in key order, only changing state when the key changes. The view space
+                    // program takes the material table row as an attribute value, the others bind the
+                    // mesh's model material.
+                    glUniform1i(glGetUniformLocation(program, "instanced"), 0);
+                    bool tableMaterials = program == viewSpaceShaderID;
+                    int currentMaterial = -1, currentMesh = -1;
+                    for (unsigned int k = 0; k < numOpaque; k++)
+                    {
+                        if (!written(k, !depthOnly))
+                            continue;
+                        uint64_t key = renderQueue.items[k].key;
+                        int material = RenderQueue::material(key);
+                        int mesh = RenderQueue::mesh(key);
+                        if (!depthOnly && tableMaterials && material != currentMaterial)
+                        {
+                            glVertexAttribI1i(materialAttribute, material);
+                            currentMaterial = material;
+                        }
+                        else if (!depthOnly && !tableMaterials && mesh != currentMesh)
+                        {
+                            batches[mesh].model->bindMaterial(program);
+                            currentMesh = mesh;
+                        }
+
+                        glBindBufferRange(GL_UNIFORM_BUFFER, objectBlockBinding, streamBuffer.buffer, objectOffsets[k], sizeof(ObjectUniforms));
+                        if (!depthOnly && packet.lightSelection)
+                            glBindBufferRange(GL_UNIFORM_BUFFER, lightBlockBinding, streamBuffer.buffer, lightOffsets[k], maxLights * sizeof(LightUniforms));
+                        batches[RenderQueue::mesh(key)].model->drawMesh();
+                    }
+                }
+            };
+
+            // Opaque geometry goes to the G-buffer when deferred, otherwise it is lit as it is drawn
+            unsigned int &opaqueShaderID = packet.deferred ? deferred.geometryShaderID : packet.clustered ? clustered.shaderID : forwardShaderID;
+            if (!packet.deferred && packet.clustered)
+                clustered.upload(packet.clusters, packet.projection, packet.near, packet.far);
+            auto drawOpaqueStage = [&]()
+            {
+                glUseProgram(opaqueShaderID);
+                glUniformMatrix4fv(glGetUniformLocation(opaqueShaderID, "V"), 1, GL_FALSE, &packet.view[0][0]);
+                if (!packet.deferred && packet.depthPrepass)
+                {
+                    // Lay down the opaque depth first so the lighting shader runs once per visible sample
+                    glUseProgram(depthShaderID);
+                    glUniformMatrix4fv(glGetUniformLocation(depthShaderID, "V"), 1, GL_FALSE, &packet.view[0][0]);
+                    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                    drawOpaque(depthShaderID, true);
+                    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                    glDepthFunc(GL_EQUAL);
+                    glDepthMask(GL_FALSE);
+                    glUseProgram(opaqueShaderID);
+                }
+
+                // Count the samples reaching the opaque shader, read back a few frames later to avoid stalling
+                glBeginQuery(GL_SAMPLES_PASSED, sampleQueries[queryFrame % numSampleQueries]);
+                drawOpaque(opaqueShaderID, false);
+
+                if (!packet.gpuCulling && packet.geometryPool)
+                {
+                    // The pool is not in the pre-pass, so it is depth tested and written as usual
+                    glDepthFunc(GL_LESS);
+                    glDepthMask(GL_TRUE);
+
+                    // Queue every object into the shared pool and draw all meshes with one indirect call
+                    for (unsigned int b = 0; b < batches.size(); b++)
+                    {
+                        if (batches[b].meshID < 0)
+                            continue;
+                        for (unsigned int m = 0; m < packet.instances[b].size(); m++)
+                            geometryPool.addInstance(batches[b].meshID, packet.instances[b][m], packet.instanceMaterials[b][m]);
+                    }
+
+                    // The view space program reads each instance's material table row, the others
+                    // have the pool bind each model's material
+                    glUniform1i(glGetUniformLocation(opaqueShaderID, "instanced"), 1);
+                    glUniformMatrix4fv(glGetUniformLocation(opaqueShaderID, "P"), 1, GL_FALSE, &packet.projection[0][0]);
+                    geometryPool.submit(opaqueShaderID, streamBuffer, opaqueShaderID == viewSpaceShaderID);
+                }
+                glEndQuery(GL_SAMPLES_PASSED);
+                glDepthFunc(GL_LESS);
+                glDepthMask(GL_TRUE);
+            };
+
+            // G-buffer and light buffer, the first pass fills one and the second lights it
+            DeferredTargets deferredTargets = {};
+            unsigned int gBuffer[4] = {}, lightBuffer = 0, lightDepth = 0;
+            if (packet.deferred)
+            {
+                gBuffer[0] = graph.create("albedo", TargetDesc(1024, 768, TargetRGBA8));
+                gBuffer[1] = graph.create("normal", TargetDesc(1024, 768, TargetRG16F));
+                gBuffer[2] = graph.create("material", TargetDesc(1024, 768, TargetRGBA8));
+                gBuffer[3] = graph.create("g-buffer depth", TargetDesc(1024, 768, TargetDepth24Stencil8));
+                lightBuffer = graph.create("light", TargetDesc(1024, 768, TargetRGBA16F));
+                lightDepth = graph.create("light depth", TargetDesc(1024, 768, TargetDepth24Stencil8));
+
+                unsigned int pass = graph.addPass("g-buffer", [&]()
+                {
+                    deferredTargets.gBufferFBO = pool.framebuffer(std::vector<unsigned int>(gBuffer, gBuffer + 3), gBuffer[3]);
+                    deferredTargets.albedoTexture = pool.texture(gBuffer[0]);
+                    deferredTargets.normalTexture = pool.texture(gBuffer[1]);
+                    deferredTargets.materialTexture = pool.texture(gBuffer[2]);
+                    deferredTargets.depthTexture = pool.texture(gBuffer[3]);
+                    deferred.beginGeometry(deferredTargets);
+                    drawOpaqueStage();
+                });
+                for (unsigned int g = 0; g < 4; g++)
+                    graph.write(pass, gBuffer[g]);
+
+                pass = graph.addPass("deferred lighting", [&]()
+                {
+                    deferredTargets.lightFBO = pool.framebuffer(lightBuffer, lightDepth);
+                    deferredTargets.lightTexture = pool.texture(lightBuffer);
+                    deferred.drawLights(deferredTargets, packet.lights, packet.view, packet.projection);
+                });
+                for (unsigned int g = 0; g < 4; g++)
+                    graph.read(pass, gBuffer[g]);
+                graph.write(pass, lightBuffer);
+                graph.write(pass, lightDepth);
+            }
+
+            // Opaque stage or the lit G-buffer and its depth, then the transparent draws over them
+            unsigned int scenePass = graph.addPass("scene", [&]()
+            {
+                unsigned int sceneFramebuffer = pool.framebuffer(sceneColour, sceneDepth);
+                glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+                if (packet.upscaling)
+                    glViewport(0, 0, packet.renderWidth, packet.renderHeight);
+                else
+                    glViewport(0, 0, 1024, 768);
+                glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                if (packet.deferred)
+                {
+                    deferred.composite(deferredTargets, sceneFramebuffer);
+                    glUseProgram(forwardShaderID);
+                }
+                else
+                    drawOpaqueStage();
+
+                if (!packet.gpuCulling && !packet.geometryPool && numOpaque < renderQueue.items.size())
+                {
+                    // Transparent draws are blended back to front over the opaque depth without writing it
+                    glDepthFunc(GL_LESS);
+                    glDepthMask(GL_FALSE);
+                    glEnable(GL_BLEND);
+                    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                    glUniform1i(glGetUniformLocation(forwardShaderID, "instanced"), 0);
+                    for (unsigned int k = numOpaque; k < renderQueue.items.size(); k++)
+                    {
+                        if (!written(k, true))
+                            continue;
+                        uint64_t key = renderQueue.items[k].key;
+                        if (forwardShaderID == viewSpaceShaderID)
+                            glVertexAttribI1i(materialAttribute, RenderQueue::material(key));
+                        else
+                            batches[RenderQueue::mesh(key)].model->bindMaterial(forwardShaderID);
+                        glBindBufferRange(GL_UNIFORM_BUFFER, objectBlockBinding, streamBuffer.buffer, objectOffsets[k], sizeof(ObjectUniforms));
+                        if (packet.lightSelection)
+                            glBindBufferRange(GL_UNIFORM_BUFFER, lightBlockBinding, streamBuffer.buffer, lightOffsets[k], maxLights * sizeof(LightUniforms));
+                        batches[RenderQueue::mesh(key)].model->drawMesh();
+                    }
+                    glDisable(GL_BLEND);
+                    glDepthMask(GL_TRUE);
+                }
+            });
+            if (packet.shadows)
+                graph.read(scenePass, shadowAtlasTarget);
+            if (packet.deferred)
+            {
+                graph.read(scenePass, lightBuffer);
+                graph.read(scenePass, gBuffer[3]);
+            }
+            graph.write(scenePass, sceneColour);
+            graph.write(scenePass, sceneDepth);
+
+            // Accumulate into the output resolution history and show it, or anti-alias
+            if (packet.upscaling)
+                upscaler.addPasses(graph, pool, sceneColour, sceneDepth, backbuffer, packet.renderWidth,
+                                   packet.renderHeight, packet.viewProjection, packet.jitter);
+            else
+                antiAliasing.addPasses(graph, pool, packet.antiAliasing, sceneColour, backbuffer);
+
+            // This frame's depth for the next GPU cull, the pyramid belongs to the culler
+            if (packet.gpuCulling)
+            {
+                unsigned int hiZ = graph.import("hi-z", 0, true);
+                unsigned int pass = graph.addPass("hi-z", [&]()
+                {
+                    gpuCuller.buildHiZ(packet.projection * packet.view, pool.framebuffer(-1, sceneDepth));
+                });
+                graph.read(pass, sceneDepth);
+                graph.write(pass, hiZ);
+            }
+
+            if (graph.compile())
+            {
+                pool.acquire(graph);
+                graph.execute();
+            }
+            glUseProgram(forwardShaderID);
+            glEndQuery(GL_TIME_ELAPSED);
+
+            queryFrame++;
+            if (queryFrame >= numSampleQueries)
+            {
+                unsigned int query = sampleQueries[queryFrame % numSampleQueries];
+                int available = 0;
+                glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available)
+                    glGetQueryObjectuiv(query, GL_QUERY_RESULT, &shadedSamples);
+
+                query = timeQueries[queryFrame % numSampleQueries];
+                glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available)
+                {
+                    GLuint64 nanoseconds = 0;
+                    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+                    gpuMilliseconds = nanoseconds / 1.0e6f;
+                    gpuScale = timeScales[queryFrame % numSampleQueries];
+                }
+            }
+            packet.stats.shadedSamples = shadedSamples;
+            packet.stats.gpuMilliseconds = gpuMilliseconds;
+            packet.stats.gpuScale = gpuScale;
+
+            packet.stats.bytesStreamed = static_cast<unsigned int>(streamBuffer.bytesUsed());
+            streamBuffer.endFrame();
+
+            packet.stats.gpuVisible = gpuCuller.numVisible;
+            packet.stats.gpuInstances = gpuCuller.numInstances;
+            packet.stats.chunkDraws = staticBatch.drawCalls;
+            packet.stats.lightVolumes = deferred.numLightVolumes;
+            packet.stats.antiAliasingMilliseconds = antiAliasing.resolveMilliseconds;
+            packet.stats.graphPasses = graph.numPasses;
+            packet.stats.graphCulled = graph.numCulled;
+            packet.stats.transientBytes = graph.transientBytes;
+            packet.stats.aliasedBytes = graph.aliasedBytes;
+            packet.stats.pooledBytes = pool.allocatedBytes;
+            packet.stats.submitMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            handoff.endRead();
+
+            glfwSwapBuffers(window);
+        }
+        glDeleteQueries(numSampleQueries, sampleQueries);
+        glDeleteQueries(numSampleQueries, timeQueries);
+        glfwMakeContextCurrent(NULL);
+    });
+
+    // Main loop, prepares the frames
+    float simulationTime = 0.0f, submitTime = 0.0f;
+    float gpuTime = 0.0f, gpuPeak = 0.0f;
+    unsigned int jitterFrame = 0;
     while (!glfwWindowShouldClose(window))
     {
         float time = glfwGetTime();
         deltaTime = time - previousTime;
         previousTime = time;
+        auto start = std::chrono::high_resolution_clock::now();
 
         keyboardInput(window);
         mouseInput(window);
 
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
         camera.target = camera.eye + camera.front;
         camera.quaternionCamera();
-        glUseProgram(shaderID);
 
-        lightSources.toShader(shaderID, camera.view);
-        glUniformMatrix4fv(glGetUniformLocation(shaderID, "V"), 1, GL_FALSE, &camera.view[0][0]);
+        // Rebuild the matrices and bounds of changed entities and refit their proxies
+        transforms.update();
+        changedEntities.clear();
+        entities.updateTransforms(transforms, changedEntities);
+        for (unsigned int c = 0; c < changedEntities.size(); c++)
+        {
+            objectTree.update(objectProxies[changedEntities[c]], entities.bounds.box(changedEntities[c]));
+            if (entities.flags[changedEntities[c]] & EntityStatic)
+                shadowAtlas.invalidate(entities.bounds.box(changedEntities[c]));
+        }
+
+        // Wait for the render thread to release the packet it drew two frames ago
+        FramePacket &packet = packets[handoff.beginWrite()];
+        FrameStats rendered = packet.stats;
+        submitTime += rendered.submitMilliseconds;
+        gpuTime += rendered.gpuMilliseconds;
+        gpuPeak = std::max(gpuPeak, rendered.gpuMilliseconds);
+        packet.view = camera.view;
+        packet.projection = camera.projection;
+        packet.gpuCulling = useGPUCulling;
+        packet.staticBatching = useStaticBatching;
+        packet.geometryPool = useGeometryPool;
+        packet.instancing = useInstancing;
+        packet.depthPrepass = useDepthPrepass;
+        packet.deferred = useDeferredShading;
+        packet.clustered = useClusteredShading && !useDeferredShading;
+        packet.viewSpaceLighting = useViewSpaceLighting;
+        packet.shadows = useShadows && useViewSpaceLighting;
+        packet.near = camera.near;
+        packet.far = camera.far;
+        packet.lightSelection = useLightSelection && !packet.deferred && !packet.clustered &&
+                                !useGPUCulling && !useGeometryPool && !useInstancing;
+
+        // Forward paths drawing straight to the screen can be upscaled, the deferred and clustered
+        // targets and the GPU culler's depth pyramid are tied to the window size. The scale follows
+        // the GPU time of a frame a few frames back and the projection is jittered by a sub-pixel
+        // offset at that size.
+        packet.upscaling = useDynamicResolution && !packet.deferred && !packet.clustered && !useGPUCulling;
+        if (packet.upscaling)
+        {
+            resolution.update(rendered.gpuMilliseconds, rendered.gpuScale);
+            packet.renderWidth = std::max(1, static_cast<int>(resolution.scale * 1024.0f + 0.5f));
+            packet.renderHeight = std::max(1, static_cast<int>(resolution.scale * 768.0f + 0.5f));
+            packet.jitter = TemporalUpscaler::jitter(jitterFrame++);
+            packet.viewProjection = camera.projection * camera.view;
+            glm::vec3 offset(2.0f * packet.jitter.x / packet.renderWidth, 2.0f * packet.jitter.y / packet.renderHeight, 0.0f);
+            packet.projection = Maths::translate(offset) * camera.projection;
+        }
+        else
+            resolution.reset();
+
+        // Temporal upscaling anti-aliases by itself, the other frames use the selected mode
+        packet.antiAliasing = packet.upscaling ? AAOff : antiAliasingMode;
+        packet.lights = lightSources.lightSources;
+        packet.numSceneLights = static_cast<unsigned int>(packet.lights.size());
+        if (packet.deferred || packet.clustered || packet.lightSelection)
+        {
+            for (unsigned int l = 0; l < lightCentres.size(); l++)
+            {
+                float angle = time + 0.37f * l;
+                dynamicLights.lightSources[l].position = lightCentres[l] + glm::vec3(2.0f * cosf(angle), 0.0f, 2.0f * sinf(angle));
+            }
+            packet.lights.insert(packet.lights.end(), dynamicLights.lightSources.begin(), dynamicLights.lightSources.end());
+        }
+
+        // Plan the shadow tiles and find what each refreshed tile and each dynamic caster has to draw
+        packet.shadowRefresh.clear();
+        packet.shadowCasters.clear();
+        if (packet.shadows)
+        {
+            shadowAtlas.update(packet.lights, camera.view, camera.projection, camera.near);
+            packet.shadowRefresh = shadowAtlas.refreshTiles;
+            packet.shadowChunks.resize(packet.shadowRefresh.size());
+            for (unsigned int r = 0; r < packet.shadowRefresh.size(); r++)
+            {
+                const ShadowTile &tile = shadowAtlas.tiles[packet.shadowRefresh[r]];
+                packet.shadowChunks[r].clear();
+                Culling::cullBoxes(Frustum(tile.projection * tile.view), chunkBounds, 1.0f, 0.0f, packet.shadowChunks[r]);
+            }
+            for (unsigned int t = 0; t < shadowAtlas.tiles.size(); t++)
+            {
+                const ShadowTile &tile = shadowAtlas.tiles[t];
+                if (!tile.valid || dynamicEntities.empty())
+                    continue;
+                visibleCasters.clear();
+                Culling::cullCandidates(Frustum(tile.projection * tile.view), entities.bounds, 1.0f, 0.0f, dynamicEntities, visibleCasters);
+                for (unsigned int v = 0; v < visibleCasters.size(); v++)
+                {
+                    ShadowCaster caster;
+                    caster.tile = t;
+                    caster.mesh = entities.meshes[visibleCasters[v]];
+                    caster.MVP = tile.projection * tile.view * entities.worlds[visibleCasters[v]];
+                    packet.shadowCasters.push_back(caster);
+                }
+            }
+        }
+        packet.shadowTiles = shadowAtlas.tiles;
+        std::copy(shadowAtlas.cascadeSplits, shadowAtlas.cascadeSplits + numCascades, packet.cascadeSplits);
+
+        // Bin the lights into the camera's froxels on the worker threads
+        if (packet.clustered)
+            packet.clusters.build(packet.lights, camera.view, camera.projection, camera.near, camera.far);
+        std::vector<unsigned int> &visibleChunks = packet.visibleChunks;
+
+        // PVS and frustum culling
+        visibleObjects.clear();
+        visibleChunks.clear();
+        if (!useGPUCulling)
+        {
+            // The camera cell's potentially visible sets replace the full lists
+            const std::vector<unsigned int> *objectCandidates = usePVS ? objectPVS.candidates(camera.eye) : NULL;
+            const std::vector<unsigned int> *chunkCandidates = usePVS ? chunkPVS.candidates(camera.eye) : NULL;
+
+            Frustum frustum(camera.projection * camera.view);
+            float minSize = minScreenSize / 768.0f;
+            if (objectCandidates && useFrustumCulling)
+                Culling::cullCandidates(frustum, entities.bounds, camera.projection[1][1], minSize, *objectCandidates, visibleObjects);
+            else if (objectCandidates)
+                visibleObjects = *objectCandidates;
+            else if (useFrustumCulling && useBVHCulling)
+            {
+                objectTree.maintain();
+                objectTree.queryFrustum(frustum, visibleObjects);
+            }
+            else if (useFrustumCulling)
+                Culling::cullBoxes(frustum, entities.bounds, camera.projection[1][1], minSize, visibleObjects);
+            else
+                for (unsigned int i = 0; i < entities.bounds.size(); i++)
+                    visibleObjects.push_back(i);
+
+            if (chunkCandidates && useFrustumCulling)
+                Culling::cullCandidates(frustum, chunkBounds, camera.projection[1][1], minSize, *chunkCandidates, visibleChunks);
+            else if (chunkCandidates)
+                visibleChunks = *chunkCandidates;
+            else if (useFrustumCulling)
+                Culling::cullBoxes(frustum, chunkBounds, camera.projection[1][1], minSize, visibleChunks);
+            else
+                for (unsigned int i = 0; i < chunkBounds.size(); i++)
+                    visibleChunks.push_back(i);
+        }
+
+        if (useOcclusionCulling && !useGPUCulling)
+        {
+            // Rank the visible occluders by projected size
+            occluderCandidates.clear();
+            for (unsigned int v = 0; v < visibleObjects.size(); v++)
+            {
+                unsigned int i = visibleObjects[v];
+                if (!(entities.flags[i] & EntityOccluder))
+                    continue;
+                glm::vec3 centre(entities.bounds.centreX[i], entities.bounds.centreY[i], entities.bounds.centreZ[i]);
+                glm::vec3 toObject = centre - camera.eye;
+                float size = entities.bounds.radius[i] * entities.bounds.radius[i] / std::max(glm::dot(toObject, toObject), 1e-4f);
+                occluderCandidates.push_back(std::make_pair(size, i));
+            }
+            unsigned int numOccluders = std::min(maxOccluders, static_cast<unsigned int>(occluderCandidates.size()));
+            std::partial_sort(occluderCandidates.begin(), occluderCandidates.begin() + numOccluders, occluderCandidates.end(),
+                              [](const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b) { return a.first > b.first; });
+
+            // Rasterize their box proxies
+            occlusionCuller.beginFrame(camera.projection * camera.view);
+            for (unsigned int c = 0; c < numOccluders; c++)
+            {
+                unsigned int i = occluderCandidates[c].second;
+                occlusionCuller.addOccluder(entities.localBounds[i], entities.worlds[i]);
+            }
+            occlusionCuller.rasterize();
+
+            // Remove occluded objects and chunks from the visible lists
+            unsigned int numVisible = 0;
+            for (unsigned int v = 0; v < visibleObjects.size(); v++)
+            {
+                unsigned int i = visibleObjects[v];
+                if (occlusionCuller.isVisible(entities.bounds.box(i)))
+                    visibleObjects[numVisible++] = i;
+            }
+            visibleObjects.resize(numVisible);
+
+            numVisible = 0;
+            for (unsigned int v = 0; v < visibleChunks.size(); v++)
+            {
+                if (occlusionCuller.isVisible(chunkBounds.box(visibleChunks[v])))
+                    visibleChunks[numVisible++] = visibleChunks[v];
+            }
+            visibleChunks.resize(numVisible);
+        }
+
+        // Gather what the render thread needs for the selected path
+        for (unsigned int b = 0; b < batches.size(); b++)
+        {
+            packet.instances[b].clear();
+            packet.instanceMaterials[b].clear();
+        }
+        if (!useGPUCulling && (useGeometryPool || useInstancing))
+        {
+            for (unsigned int v = 0; v < visibleObjects.size(); v++)
+            {
+                unsigned int i = visibleObjects[v];
+                if (useStaticBatching && (entities.flags[i] & EntityStatic))
+                    continue;
+
+                packet.instances[entities.meshes[i]].push_back(entities.worlds[i]);
+                packet.instanceMaterials[entities.meshes[i]].push_back(entities.materials[i]);
+            }
+        }
+        else if (!useGPUCulling)
+        {
+            // Key, transform and sort the visible objects on the worker threads
+            packet.drawList.build(entities, &visibleObjects, camera.view, packet.projection, camera.near, camera.far,
+                                  minScreenSize / 768.0f, useStaticBatching ? EntityStatic : 0);
+
+            // Keep the lights reaching each draw, objects away from the local lights only get the global ones
+            if (packet.lightSelection)
+                packet.selection.build(packet.lights, entities.bounds, packet.drawList.entityIndices);
+        }
+        else
+            packet.drawList.queue.clear();
 
-        for (unsigned int i = 0; i < static_cast<unsigned int>(objects.size()); i++)
+        // Print frame statistics once a second, before the packet is handed over. The render
+        // thread's figures are from the packet's last frame, two frames ago.
+        simulationTime += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        frameCount++;
+        if (time - statsTime >= 1.0f)
         {
-            glm::mat4 translate = Maths::translate(objects[i].position);
-            glm::mat4 scale = Maths::scale(objects[i].scale);
-            glm::mat4 rotate = Maths::rotate(objects[i].angle, objects[i].rotation);
-            glm::mat4 model = translate * rotate * scale;
-
-            glm::mat4 MV = camera.view * model;
-            glm::mat4 MVP = camera.projection * MV;
-            glUniformMatrix4fv(glGetUniformLocation(shaderID, "MVP"), 1, GL_FALSE, &MVP[0][0]);
-            glUniformMatrix4fv(glGetUniformLocation(shaderID, "MV"), 1, GL_FALSE, &MV[0][0]);
-
-            if (objects[i].name == "cube")
-                cube.draw(shaderID);
+            printf("%.2f ms/frame (%.2f ms simulation, %.2f ms submission, %s), %u KB streamed",
+                   1000.0f * (time - statsTime) / frameCount, simulationTime / frameCount, submitTime / frameCount,
+                   overlapRendering ? "overlapped" : "serial", rendered.bytesStreamed / 1024);
+            if (useDeferredShading)
+                printf(", deferred: %u K G-buffer samples, %u of %u light volumes",
+                       rendered.shadedSamples / 1000, rendered.lightVolumes, static_cast<unsigned int>(lightCentres.size()));
+            else
+                printf(", %u K shaded samples%s", rendered.shadedSamples / 1000, useDepthPrepass ? " after depth pre-pass" : "");
+            if (packet.clustered)
+                printf(", clustered: %u lights, %u indices, at most %u per cluster, %.2f ms binning",
+                       packet.clusters.numLocalLights, static_cast<unsigned int>(packet.clusters.lightIndices.size()),
+                       packet.clusters.maxLightsPerCluster, packet.clusters.buildMilliseconds);
+            if (useGPUCulling)
+                printf(", %u of %u objects visible on the GPU", rendered.gpuVisible, rendered.gpuInstances);
+            else
+            {
+                printf(", %u visible, %u culled objects", static_cast<unsigned int>(visibleObjects.size()),
+                       entities.bounds.size() - static_cast<unsigned int>(visibleObjects.size()));
+                if (useOcclusionCulling)
+                    printf(" (%u occluded)", occlusionCuller.numOccluded);
+            }
+            if (useStaticBatching && !useGPUCulling)
+                printf(", %u static chunk draws", rendered.chunkDraws);
+            if (packet.shadows)
+                printf(", shadows: %u lights, %u of %u stale tiles refreshed, %u shadow draws",
+                       shadowAtlas.numShadowedLights, static_cast<unsigned int>(packet.shadowRefresh.size()),
+                       shadowAtlas.numStale, rendered.shadowDraws);
+            if (!useGPUCulling && !useGeometryPool && !useInstancing)
+                printf(", %u draws, %u shader, %u material, %u mesh changes, %.2f ms draw list",
+                       packet.drawList.queue.stats.drawCalls, packet.drawList.queue.stats.shaderChanges,
+                       packet.drawList.queue.stats.materialChanges, packet.drawList.queue.stats.meshChanges,
+                       packet.drawList.cullMilliseconds + packet.drawList.mergeMilliseconds + packet.drawList.sortMilliseconds);
+            if (packet.lightSelection)
+                printf(", light selection: %.1f lights per draw from %u local lights, %u light blocks, %.2f ms",
+                       packet.selection.averageLights, packet.selection.numLocalLights,
+                       rendered.lightBlocks, packet.selection.buildMilliseconds);
+            printf(", %.2f ms GPU (peak %.2f)", gpuTime / frameCount, gpuPeak);
+            if (!packet.upscaling)
+                printf(", AA %s: %.2f ms resolve", AntiAliasing::name(packet.antiAliasing), rendered.antiAliasingMilliseconds);
+            if (packet.upscaling)
+                printf(", dynamic resolution: %dx%d (%.2f scale, %.2f of %.2f ms budget, %u changes)",
+                       packet.renderWidth, packet.renderHeight, resolution.scale, resolution.smoothedMilliseconds,
+                       resolution.budgetMilliseconds, resolution.numChanges);
+            printf(", graph: %u passes (%u culled), %u KB transient, %u KB aliased, %u KB pooled",
+                   rendered.graphPasses, rendered.graphCulled, rendered.transientBytes / 1024, rendered.aliasedBytes / 1024,
+                   rendered.pooledBytes / 1024);
+            printf("\n");
+            statsTime = time;
+            frameCount = 0;
+            simulationTime = 0.0f;
+            submitTime = 0.0f;
+            gpuTime = 0.0f;
+            gpuPeak = 0.0f;
         }
 
-        glfwSwapBuffers(window);
+        // Hand the packet over, without overlap the frame is drawn before the next one starts
+        handoff.endWrite();
+        if (!overlapRendering)
+            handoff.waitIdle();
+
         glfwPollEvents();
     }
 
+    // Let the render thread finish its frames and take the context back for cleanup
+    handoff.stop();
+    renderThread.join();
+    glfwMakeContextCurrent(window);
+
     cube.deleteBuffers();
+    geometryPool.deleteBuffers();
+    staticBatch.deleteBuffers();
+    gpuCuller.deleteBuffers();
+    deferred.deleteBuffers();
+    clustered.deleteBuffers();
+    streamBuffer.deleteBuffers();
     glDeleteProgram(shaderID);
+    glDeleteProgram(viewSpaceShaderID);
+    shadowMaps.deleteBuffers();
+    materialTable.deleteBuffers();
+    upscaler.deleteBuffers();
+    antiAliasing.deleteBuffers();
+    pool.deleteBuffers();
+    glDeleteProgram(depthShaderID);
     glfwTerminate();
     return 0;
 }
@@ -179,6 +1227,103 @@ void keyboardInput(GLFWwindow* window)
         camera.eye -= cameraSpeed * camera.right;
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.eye += cameraSpeed * camera.right;
+
+    // Render option toggles
+    if (keyPressed(window, GLFW_KEY_I))
+    {
+        useInstancing = !useInstancing;
+        printf("Instancing %s\n", useInstancing ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_G))
+    {
+        useGeometryPool = !useGeometryPool;
+        printf("Geometry pool %s\n", useGeometryPool ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_B))
+    {
+        useStaticBatching = !useStaticBatching;
+        printf("Static batching %s\n", useStaticBatching ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_C))
+    {
+        useFrustumCulling = !useFrustumCulling;
+        printf("Frustum culling %s\n", useFrustumCulling ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_H))
+    {
+        useBVHCulling = !useBVHCulling;
+        printf("Hierarchical culling %s\n", useBVHCulling ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_O))
+    {
+        useOcclusionCulling = !useOcclusionCulling;
+        printf("Occlusion culling %s\n", useOcclusionCulling ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_U))
+    {
+        useGPUCulling = !useGPUCulling;
+        printf("GPU culling %s\n", useGPUCulling ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_P))
+    {
+        usePVS = !usePVS;
+        printf("PVS %s\n", usePVS ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_Z))
+    {
+        useDepthPrepass = !useDepthPrepass;
+        printf("Depth pre-pass %s\n", useDepthPrepass ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_F))
+    {
+        useDeferredShading = !useDeferredShading;
+        printf("Deferred shading %s\n", useDeferredShading ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_K))
+    {
+        useClusteredShading = !useClusteredShading;
+        printf("Clustered shading %s\n", useClusteredShading ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_L))
+    {
+        useLightSelection = !useLightSelection;
+        printf("Per-object light selection %s\n", useLightSelection ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_V))
+    {
+        useViewSpaceLighting = !useViewSpaceLighting;
+        printf("Lighting in %s space\n", useViewSpaceLighting ? "view" : "tangent");
+    }
+    if (keyPressed(window, GLFW_KEY_M))
+    {
+        useShadows = !useShadows;
+        printf("Shadows %s\n", useShadows ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_T))
+    {
+        useDynamicResolution = !useDynamicResolution;
+        printf("Dynamic resolution with temporal upscaling %s\n", useDynamicResolution ? "on" : "off");
+    }
+    if (keyPressed(window, GLFW_KEY_X))
+    {
+        antiAliasingMode = static_cast<AntiAliasingMode>((antiAliasingMode + 1) % numAntiAliasingModes);
+        printf("Anti-aliasing %s%s\n", AntiAliasing::name(antiAliasingMode), useDynamicResolution ? " when not upscaling" : "");
+    }
+    if (keyPressed(window, GLFW_KEY_R))
+    {
+        overlapRendering = !overlapRendering;
+        printf("Render thread overlap %s\n", overlapRendering ? "on" : "off");
+    }
+}
+
+bool keyPressed(GLFWwindow* window, int key)
+{
+    // Returns true only on the frame the key goes down
+    static bool keyDown[GLFW_KEY_LAST + 1] = { false };
+    bool down = glfwGetKey(window, key) == GLFW_PRESS;
+    bool pressed = down && !keyDown[key];
+    keyDown[key] = down;
+    return pressed;
 }
 
 void mouseInput(GLFWwindow* window)
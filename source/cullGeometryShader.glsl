@@ -0,0 +1,28 @@
+#version 330 core
+
+layout(points) in;
+layout(points, max_vertices = 1) out;
+
+// Inputs
+in mat4 model[];
+flat in int visible[];
+
+// Outputs, captured by transform feedback as the instance model matrices
+out vec4 column0;
+out vec4 column1;
+out vec4 column2;
+out vec4 column3;
+
+void main()
+{
+    // Only visible instances are emitted, which compacts the output buffer
+    if (visible[0] == 1)
+    {
+        column0 = model[0][0];
+        column1 = model[0][1];
+        column2 = model[0][2];
+        column3 = model[0][3];
+        EmitVertex();
+        EndPrimitive();
+    }
+}
@@ -0,0 +1,75 @@
+#version 330 core
+
+// Inputs, one vertex per instance
+layout(location = 0) in mat4 instanceModel;
+layout(location = 4) in vec3 boundsCentre;
+layout(location = 5) in vec3 boundsExtent;
+
+// Outputs
+out mat4 model;
+flat out int visible;
+
+// Uniforms
+uniform vec4 frustumPlanes[6];
+uniform bool useHiZ;
+uniform mat4 previousVP;
+uniform sampler2D hiZMap;
+uniform vec2 hiZSize;
+uniform int hiZLevels;
+
+// Function prototypes
+bool insideFrustum();
+bool passesHiZ();
+
+void main()
+{
+    model = instanceModel;
+    visible = insideFrustum() && (!useHiZ || passesHiZ()) ? 1 : 0;
+}
+
+// Test the world space box against the frustum planes
+bool insideFrustum()
+{
+    for (int i = 0; i < 6; i++)
+    {
+        float d = dot(frustumPlanes[i].xyz, boundsCentre) + frustumPlanes[i].w;
+        float r = dot(abs(frustumPlanes[i].xyz), boundsExtent);
+        if (d + r < 0.0)
+            return false;
+    }
+    return true;
+}
+
+// Test the box against last frame's depth pyramid
+bool passesHiZ()
+{
+    vec2 rectMin = vec2(1.0);
+    vec2 rectMax = vec2(0.0);
+    float minDepth = 1.0;
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 corner = boundsCentre + boundsExtent * vec3((i & 1) == 0 ? -1.0 : 1.0,
+                                                         (i & 2) == 0 ? -1.0 : 1.0,
+                                                         (i & 4) == 0 ? -1.0 : 1.0);
+        vec4 clip = previousVP * vec4(corner, 1.0);
+        
+        // Boxes crossing the near plane are always visible
+        if (clip.w <= 0.0)
+            return true;
+        
+        vec3 ndc = clip.xyz / clip.w;
+        rectMin = min(rectMin, 0.5 * ndc.xy + 0.5);
+        rectMax = max(rectMax, 0.5 * ndc.xy + 0.5);
+        minDepth = min(minDepth, 0.5 * ndc.z + 0.5);
+    }
+    rectMin = clamp(rectMin, 0.0, 1.0);
+    rectMax = clamp(rectMax, 0.0, 1.0);
+    
+    // Level at which the rectangle covers at most 2x2 texels
+    vec2 size = (rectMax - rectMin) * hiZSize;
+    float lod = clamp(ceil(log2(max(max(size.x, size.y), 1.0))), 0.0, float(hiZLevels - 1));
+    
+    float maxDepth = max(max(textureLod(hiZMap, rectMin, lod).r, textureLod(hiZMap, vec2(rectMax.x, rectMin.y), lod).r),
+                         max(textureLod(hiZMap, vec2(rectMin.x, rectMax.y), lod).r, textureLod(hiZMap, rectMax, lod).r));
+    return minDepth <= maxDepth;
+}
@@ -0,0 +1,74 @@
+#version 330 core
+
+// Outputs
+out vec3 fragmentColour;
+
+// G-buffer
+uniform sampler2D albedoMap;
+uniform sampler2D normalMap;
+uniform sampler2D materialMap;
+uniform sampler2D depthMap;
+uniform mat4 inverseP;
+uniform vec2 screenSize;
+
+// View space light
+uniform vec3 lightPosition;
+uniform vec3 lightDirection;
+uniform vec3 lightColour;
+uniform float constant;
+uniform float linear;
+uniform float quadratic;
+uniform float cosPhi;
+uniform int type;
+
+vec3 octahedralDecode(vec2 f)
+{
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    // Reconstruct the view space position from the depth
+    vec2 uv = gl_FragCoord.xy / screenSize;
+    float depth = texture(depthMap, uv).r;
+    if (depth == 1.0)
+        discard;
+    vec4 position = inverseP * vec4(2.0 * vec3(uv, depth) - 1.0, 1.0);
+    vec3 fragmentPosition = position.xyz / position.w;
+
+    // Surface
+    vec4 albedo       = texture(albedoMap, uv);
+    vec4 material     = texture(materialMap, uv);
+    vec3 normal       = octahedralDecode(texture(normalMap, uv).xy);
+    vec3 objectColour = albedo.rgb;
+    float ka          = albedo.a;
+    float kd          = material.r;
+    float ks          = material.g;
+    float Ns          = material.a * 255.0;
+
+    // Same lighting model as the forward shader
+    vec3 light = type == 3 ? normalize(-lightDirection) : normalize(lightPosition - fragmentPosition);
+    vec3 ambient    = ka * objectColour;
+    float cosTheta  = max(dot(normal, light), 0);
+    vec3 diffuse    = kd * lightColour * objectColour * cosTheta;
+    vec3 reflection = - light + 2 * dot(light, normal) * normal;
+    vec3 camera     = normalize(-fragmentPosition);
+    float cosAlpha  = max(dot(camera, reflection), 0);
+    vec3 specular   = ks * lightColour * pow(cosAlpha, Ns) * material.b;
+    fragmentColour  = ambient + diffuse + specular;
+
+    if (type != 3)
+    {
+        float distance    = length(lightPosition - fragmentPosition);
+        fragmentColour   /= constant + linear * distance + quadratic * distance * distance;
+    }
+    if (type == 2)
+    {
+        float delta = radians(2.0);
+        fragmentColour *= clamp((dot(-light, normalize(lightDirection)) - cosPhi) / delta, 0.0, 1.0);
+    }
+}
@@ -0,0 +1,31 @@
+#version 330 core
+
+// Inputs, only the position stream is read
+layout(location = 0) in vec3 position;
+layout(location = 5) in mat4 instanceModel;
+
+// Must match vertexShader.glsl exactly so the depth equals the main pass
+invariant gl_Position;
+
+// Uniforms
+layout(std140) uniform ObjectBlock
+{
+    mat4 MVP;
+    mat4 MV;
+};
+uniform mat4 V;
+uniform mat4 P;
+uniform bool instanced;
+
+void main()
+{
+    // Same matrix products as the main vertex shader
+    mat4 modelViewProjection = MVP;
+    if (instanced)
+    {
+        mat4 modelView = V * instanceModel;
+        modelViewProjection = P * modelView;
+    }
+
+    gl_Position = modelViewProjection * vec4(position, 1.0);
+}
@@ -15,10 +15,10 @@ out vec3 fragmentColour;
 struct Light
 {
     vec3 position;
-    vec3 colour;
-    vec3 direction;
     float constant;
+    vec3 colour;
     float linear;
+    vec3 direction;
     float quadratic;
     float cosPhi;
     int type;
@@ -32,7 +32,10 @@ uniform float ka;
 uniform float kd;
 uniform float ks;
 uniform float Ns;
-uniform Light lightSources[maxLights];
+layout(std140) uniform LightBlock
+{
+    Light lightSources[maxLights];
+};
 
 // Function prototypes
 vec3 pointLight(vec3 lightPosition, vec3 lightColour,
@@ -51,6 +54,10 @@ void main ()
     fragmentColour = vec3(0.0, 0.0, 0.0);
     for (int i = 0; i < maxLights; i++)
     {
+        // Lights are packed, the first unused slot ends the list
+        if (lightSources[i].type == 0)
+            break;
+        
         // Determine light properties for current light source
         vec3 lightPosition  = tangentSpaceLightPosition[i];
         vec3 lightColour    = lightSources[i].colour;
@@ -0,0 +1,12 @@
+#version 330 core
+
+// Outputs
+out vec2 UV;
+
+void main()
+{
+    // Full screen triangle generated from the vertex ID, no vertex buffers are needed
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    UV = position;
+    gl_Position = vec4(2.0 * position - 1.0, 0.0, 1.0);
+}
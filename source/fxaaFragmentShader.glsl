@@ -0,0 +1,135 @@
+#version 330 core
+
+// Inputs
+in vec2 UV;
+
+// Outputs
+out vec3 fragmentColour;
+
+// Uniforms
+uniform sampler2D image;
+uniform vec2 inverseSize;
+
+// Contrast below which a pixel is left alone, relative to its brightest neighbour and absolute
+const float edgeThreshold = 0.125;
+const float edgeThresholdMin = 0.0312;
+
+// Edge search steps in pixels, growing as the search goes further
+const int searchSteps = 12;
+const float stepSizes[searchSteps] = float[](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);
+
+float luma(vec3 colour)
+{
+    return dot(colour, vec3(0.299, 0.587, 0.114));
+}
+
+float lumaAt(vec2 uv)
+{
+    return luma(texture(image, uv).rgb);
+}
+
+void main()
+{
+    vec3 colour = texture(image, UV).rgb;
+    float lumaCentre = luma(colour);
+    float lumaDown = luma(textureOffset(image, UV, ivec2(0, -1)).rgb);
+    float lumaUp = luma(textureOffset(image, UV, ivec2(0, 1)).rgb);
+    float lumaLeft = luma(textureOffset(image, UV, ivec2(-1, 0)).rgb);
+    float lumaRight = luma(textureOffset(image, UV, ivec2(1, 0)).rgb);
+
+    // Low contrast areas are not on an edge
+    float lumaMin = min(lumaCentre, min(min(lumaDown, lumaUp), min(lumaLeft, lumaRight)));
+    float lumaMax = max(lumaCentre, max(max(lumaDown, lumaUp), max(lumaLeft, lumaRight)));
+    float range = lumaMax - lumaMin;
+    if (range < max(edgeThresholdMin, lumaMax * edgeThreshold))
+    {
+        fragmentColour = colour;
+        return;
+    }
+
+    float lumaDownLeft = luma(textureOffset(image, UV, ivec2(-1, -1)).rgb);
+    float lumaUpRight = luma(textureOffset(image, UV, ivec2(1, 1)).rgb);
+    float lumaUpLeft = luma(textureOffset(image, UV, ivec2(-1, 1)).rgb);
+    float lumaDownRight = luma(textureOffset(image, UV, ivec2(1, -1)).rgb);
+    float lumaDownUp = lumaDown + lumaUp;
+    float lumaLeftRight = lumaLeft + lumaRight;
+    float lumaLeftCorners = lumaDownLeft + lumaUpLeft;
+    float lumaDownCorners = lumaDownLeft + lumaDownRight;
+    float lumaRightCorners = lumaDownRight + lumaUpRight;
+    float lumaUpCorners = lumaUpRight + lumaUpLeft;
+
+    // Edge orientation from the second differences across the rows and columns
+    float edgeHorizontal = abs(-2.0 * lumaLeft + lumaLeftCorners) + 2.0 * abs(-2.0 * lumaCentre + lumaDownUp) +
+                           abs(-2.0 * lumaRight + lumaRightCorners);
+    float edgeVertical = abs(-2.0 * lumaUp + lumaUpCorners) + 2.0 * abs(-2.0 * lumaCentre + lumaLeftRight) +
+                         abs(-2.0 * lumaDown + lumaDownCorners);
+    bool horizontal = edgeHorizontal >= edgeVertical;
+
+    // The edge lies on the side with the steeper gradient
+    float luma1 = horizontal ? lumaDown : lumaLeft;
+    float luma2 = horizontal ? lumaUp : lumaRight;
+    float gradient1 = luma1 - lumaCentre;
+    float gradient2 = luma2 - lumaCentre;
+    bool steepest1 = abs(gradient1) >= abs(gradient2);
+    float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+    float stepLength = horizontal ? inverseSize.y : inverseSize.x;
+    float lumaLocalAverage;
+    if (steepest1)
+    {
+        stepLength = -stepLength;
+        lumaLocalAverage = 0.5 * (luma1 + lumaCentre);
+    }
+    else
+        lumaLocalAverage = 0.5 * (luma2 + lumaCentre);
+
+    // Search both ways along the edge, half a pixel over, until the average changes
+    vec2 edgeUV = UV;
+    if (horizontal)
+        edgeUV.y += 0.5 * stepLength;
+    else
+        edgeUV.x += 0.5 * stepLength;
+    vec2 offset = horizontal ? vec2(inverseSize.x, 0.0) : vec2(0.0, inverseSize.y);
+    vec2 uv1 = edgeUV - offset;
+    vec2 uv2 = edgeUV + offset;
+    float lumaEnd1 = 0.0, lumaEnd2 = 0.0;
+    bool reached1 = false, reached2 = false;
+    for (int i = 0; i < searchSteps && !(reached1 && reached2); i++)
+    {
+        if (!reached1)
+        {
+            lumaEnd1 = lumaAt(uv1) - lumaLocalAverage;
+            reached1 = abs(lumaEnd1) >= gradientScaled;
+            if (!reached1)
+                uv1 -= offset * stepSizes[i];
+        }
+        if (!reached2)
+        {
+            lumaEnd2 = lumaAt(uv2) - lumaLocalAverage;
+            reached2 = abs(lumaEnd2) >= gradientScaled;
+            if (!reached2)
+                uv2 += offset * stepSizes[i];
+        }
+    }
+
+    // Shift towards the edge by how close the nearer end is, if that end turns the right way
+    float distance1 = horizontal ? UV.x - uv1.x : UV.y - uv1.y;
+    float distance2 = horizontal ? uv2.x - UV.x : uv2.y - UV.y;
+    bool direction1 = distance1 < distance2;
+    float pixelOffset = 0.5 - min(distance1, distance2) / (distance1 + distance2);
+    bool centreSmaller = lumaCentre < lumaLocalAverage;
+    bool correctVariation = ((direction1 ? lumaEnd1 : lumaEnd2) < 0.0) != centreSmaller;
+    float finalOffset = correctVariation ? pixelOffset : 0.0;
+
+    // Sub-pixel aliasing from the contrast of the pixel against its 3x3 average
+    float lumaAverage = (1.0 / 12.0) * (2.0 * (lumaDownUp + lumaLeftRight) + lumaLeftCorners + lumaRightCorners);
+    float subPixel = clamp(abs(lumaAverage - lumaCentre) / range, 0.0, 1.0);
+    subPixel = (-2.0 * subPixel + 3.0) * subPixel * subPixel;
+    finalOffset = max(finalOffset, 0.75 * subPixel * subPixel);
+
+    vec2 finalUV = UV;
+    if (horizontal)
+        finalUV.y += finalOffset * stepLength;
+    else
+        finalUV.x += finalOffset * stepLength;
+    fragmentColour = texture(image, finalUV).rgb;
+}
@@ -0,0 +1,38 @@
+#version 330 core
+
+// Inputs
+in vec2 UV;
+in mat3 TBN;
+
+// Outputs
+layout(location = 0) out vec4 albedo;
+layout(location = 1) out vec2 octahedralNormal;
+layout(location = 2) out vec4 material;
+
+// Uniforms
+uniform sampler2D diffuseMap;
+uniform sampler2D normalMap;
+uniform sampler2D specularMap;
+uniform float ka;
+uniform float kd;
+uniform float ks;
+uniform float Ns;
+
+// Map a unit vector onto the octahedron and unfold it into [-1, 1]^2
+vec2 octahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.xy;
+}
+
+void main()
+{
+    // Same normal map lookup as the forward shader, moved to view space
+    vec3 normal = normalize(TBN * normalize(2.0 * vec3(texture(normalMap, UV)) - 1.0));
+
+    albedo = vec4(vec3(texture(diffuseMap, UV)), ka);
+    octahedralNormal = octahedralEncode(normal);
+    material = vec4(kd, ks, texture(specularMap, UV).r, Ns / 255.0);
+}
@@ -0,0 +1,50 @@
+#version 330 core
+
+// Inputs
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec3 tangent;
+layout(location = 5) in mat4 instanceModel;
+
+// Outputs
+out vec2 UV;
+out mat3 TBN;
+
+// The clustered pass reuses this shader and tests the pre-pass depth with GL_EQUAL
+invariant gl_Position;
+
+// Uniforms
+layout(std140) uniform ObjectBlock
+{
+    mat4 MVP;
+    mat4 MV;
+};
+uniform mat4 V;
+uniform mat4 P;
+uniform bool instanced;
+
+void main()
+{
+    // Instanced draws build the MV and MVP matrices from the per-instance model matrix
+    mat4 modelView = MV;
+    mat4 modelViewProjection = MVP;
+    if (instanced)
+    {
+        modelView = V * instanceModel;
+        modelViewProjection = P * modelView;
+    }
+
+    gl_Position = modelViewProjection * vec4(position, 1.0);
+    UV = uv;
+
+    // TBN matrix from tangent space to view space, a missing tangent is replaced by any perpendicular
+    mat3 invMV = transpose(inverse(mat3(modelView)));
+    vec3 n = normalize(invMV * normal);
+    vec3 t = invMV * tangent;
+    if (dot(t, t) < 1e-8)
+        t = cross(n, abs(n.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0));
+    t = normalize(t - dot(t, n) * n);
+    vec3 b = cross(n, t);
+    TBN = mat3(t, b, n);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+
+// Outputs
+out float maxDepth;
+
+// Uniforms
+uniform sampler2D depthMap;
+uniform bool copyDepth;
+uniform ivec2 previousSize;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    
+    // Level 0 is a copy of the depth buffer
+    if (copyDepth)
+    {
+        maxDepth = texelFetch(depthMap, texel, 0).r;
+        return;
+    }
+    
+    // Farthest depth of the 2x2 block in the previous level, odd sizes take a third row and column.
+    // The previous level is the texture's base level so it is fetched as level 0
+    ivec2 base = 2 * texel;
+    ivec2 last = previousSize - 1;
+    ivec2 extra = ivec2(previousSize.x & 1, previousSize.y & 1);
+    maxDepth = 0.0;
+    for (int y = 0; y <= 1 + extra.y; y++)
+        for (int x = 0; x <= 1 + extra.x; x++)
+            maxDepth = max(maxDepth, texelFetch(depthMap, min(base + ivec2(x, y), last), 0).r);
+}
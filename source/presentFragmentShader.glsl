@@ -0,0 +1,15 @@
+#version 330 core
+
+// Inputs
+in vec2 UV;
+
+// Outputs
+out vec3 fragmentColour;
+
+// Uniforms
+uniform sampler2D image;
+
+void main()
+{
+    fragmentColour = texture(image, UV).rgb;
+}
@@ -0,0 +1,45 @@
+#version 330 core
+
+// Outputs
+out vec3 fragmentColour;
+
+// Uniforms
+uniform sampler2D image;
+uniform sampler2D weights;
+
+vec4 weightsAt(ivec2 texel)
+{
+    if (any(greaterThanEqual(texel, textureSize(weights, 0))))
+        return vec4(0.0);
+    return texelFetch(weights, texel, 0);
+}
+
+vec3 colourAt(ivec2 texel)
+{
+    return texelFetch(image, clamp(texel, ivec2(0), textureSize(image, 0) - 1), 0).rgb;
+}
+
+void main()
+{
+    // Coverage by the neighbours across the pixel's own lower and left edges and
+    // across the lower edge of the pixel above and the left edge of the one right
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 own = weightsAt(texel);
+    float down = own.r;
+    float left = own.b;
+    float up = weightsAt(texel + ivec2(0, 1)).g;
+    float right = weightsAt(texel + ivec2(1, 0)).a;
+    float total = down + left + up + right;
+
+    vec3 colour = colourAt(texel);
+    if (total == 0.0)
+    {
+        fragmentColour = colour;
+        return;
+    }
+
+    vec3 blended = down * colourAt(texel + ivec2(0, -1)) + left * colourAt(texel + ivec2(-1, 0)) +
+                   up * colourAt(texel + ivec2(0, 1)) + right * colourAt(texel + ivec2(1, 0));
+    float keep = max(1.0 - total, 0.0);
+    fragmentColour = (keep * colour + blended) / (keep + total);
+}
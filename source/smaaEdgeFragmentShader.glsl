@@ -0,0 +1,38 @@
+#version 330 core
+
+// Outputs, whether the pixel has an edge with its left (r) and lower (g) neighbour
+out vec2 edges;
+
+// Uniforms
+uniform sampler2D image;
+
+// Luma difference that makes an edge
+const float threshold = 0.1;
+
+// Edges weaker than the strongest nearby one by this factor are dropped
+const float contrastAdaptation = 2.0;
+
+float luma(ivec2 texel)
+{
+    texel = clamp(texel, ivec2(0), textureSize(image, 0) - 1);
+    return dot(texelFetch(image, texel, 0).rgb, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float centre = luma(texel);
+    float left = luma(texel + ivec2(-1, 0));
+    float down = luma(texel + ivec2(0, -1));
+    vec2 delta = abs(centre - vec2(left, down));
+    vec2 edge = step(threshold, delta);
+    if (edge.x + edge.y == 0.0)
+        discard;
+
+    // Local contrast adaptation, an edge next to a much stronger one is a shading
+    // gradient rather than a silhouette
+    vec2 maxDelta = max(delta, abs(centre - vec2(luma(texel + ivec2(1, 0)), luma(texel + ivec2(0, 1)))));
+    maxDelta = max(maxDelta, abs(vec2(left, down) - vec2(luma(texel + ivec2(-2, 0)), luma(texel + ivec2(0, -2)))));
+    float strongest = max(maxDelta.x, maxDelta.y);
+    edges = edge * step(strongest, contrastAdaptation * delta);
+}
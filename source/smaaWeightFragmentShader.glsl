@@ -0,0 +1,101 @@
+#version 330 core
+
+// Outputs, for the edge below the pixel the coverage to blend into this pixel (r) and into
+// the one below (g), for the edge to its left into this pixel (b) and into the one left (a)
+out vec4 weights;
+
+// Uniforms
+uniform sampler2D image;
+
+// Longest edge run searched either way, in pixels
+const int maxSearchSteps = 16;
+
+vec2 edge(ivec2 texel)
+{
+    if (any(lessThan(texel, ivec2(0))) || any(greaterThanEqual(texel, textureSize(image, 0))))
+        return vec2(0.0);
+    return texelFetch(image, texel, 0).rg;
+}
+
+// Height of the silhouette at the end of a run, half a pixel towards the side a crossing edge is on
+float crossing(const bool positive, const bool negative)
+{
+    return positive == negative ? 0.0 : (positive ? 0.5 : -0.5);
+}
+
+// Area above (x) and below (y) the edge line under a straight piece of the silhouette
+vec2 trapezoid(const float y0, const float y1, const float width)
+{
+    float area = 0.5 * (y0 + y1) * width;
+    return vec2(max(area, 0.0), max(-area, 0.0));
+}
+
+// Areas under a line segment clipped to the pixel [0, 1], split where it crosses the edge line
+vec2 segmentArea(const float xa, const float ya, const float xb, const float yb)
+{
+    float a = max(xa, 0.0);
+    float b = min(xb, 1.0);
+    if (b <= a)
+        return vec2(0.0);
+    float slope = (yb - ya) / (xb - xa);
+    float y0 = ya + slope * (a - xa);
+    float y1 = ya + slope * (b - xa);
+    if (y0 * y1 < 0.0)
+    {
+        float split = a - y0 / slope;
+        return trapezoid(y0, 0.0, split - a) + trapezoid(0.0, y1, b - split);
+    }
+    return trapezoid(y0, y1, b - a);
+}
+
+// Coverage of the pixel a distance d1 from one end of a run and d2 from the other, the
+// silhouette runs from the height h1 at one end to h2 at the other, through the middle of
+// the run when both ends turn the same way
+vec2 area(const float d1, const float d2, const float h1, const float h2)
+{
+    float x0 = -d1;
+    float x1 = d2 + 1.0;
+    if (h1 * h2 > 0.0)
+    {
+        float middle = 0.5 * (x0 + x1);
+        return segmentArea(x0, h1, middle, 0.0) + segmentArea(middle, 0.0, x1, h2);
+    }
+    return segmentArea(x0, h1, x1, h2);
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec2 own = edge(texel);
+    weights = vec4(0.0);
+
+    // Horizontal run along the pixel's lower side, its ends are crossed by left edges above or below
+    if (own.g > 0.0)
+    {
+        int left = 0, right = 0;
+        while (left < maxSearchSteps && edge(texel - ivec2(left + 1, 0)).g > 0.0)
+            left++;
+        while (right < maxSearchSteps && edge(texel + ivec2(right + 1, 0)).g > 0.0)
+            right++;
+        ivec2 start = texel - ivec2(left, 0);
+        ivec2 end = texel + ivec2(right + 1, 0);
+        float h1 = crossing(edge(start).r > 0.0, edge(start - ivec2(0, 1)).r > 0.0);
+        float h2 = crossing(edge(end).r > 0.0, edge(end - ivec2(0, 1)).r > 0.0);
+        weights.rg = area(float(left), float(right), h1, h2);
+    }
+
+    // Vertical run along the pixel's left side, its ends are crossed by lower edges right or left of it
+    if (own.r > 0.0)
+    {
+        int down = 0, up = 0;
+        while (down < maxSearchSteps && edge(texel - ivec2(0, down + 1)).r > 0.0)
+            down++;
+        while (up < maxSearchSteps && edge(texel + ivec2(0, up + 1)).r > 0.0)
+            up++;
+        ivec2 start = texel - ivec2(0, down);
+        ivec2 end = texel + ivec2(0, up + 1);
+        float h1 = crossing(edge(start).g > 0.0, edge(start - ivec2(1, 0)).g > 0.0);
+        float h2 = crossing(edge(end).g > 0.0, edge(end - ivec2(1, 0)).g > 0.0);
+        weights.ba = area(float(down), float(up), h1, h2);
+    }
+}
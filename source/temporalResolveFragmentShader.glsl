@@ -0,0 +1,59 @@
+#version 330 core
+
+// Inputs
+in vec2 UV;
+
+// Outputs
+out vec4 fragmentColour;
+
+// Uniforms
+uniform sampler2D sceneColour;
+uniform sampler2D sceneDepth;
+uniform sampler2D history;
+uniform vec2 renderSize;
+uniform vec2 jitter;
+uniform mat4 inverseViewProjection;
+uniform mat4 previousViewProjection;
+uniform bool historyValid;
+uniform float blendFactor;
+
+void main()
+{
+    // The frame is drawn in the bottom left corner of the scene target, find this
+    // output pixel in it, shifted by the jitter the projection was drawn with
+    vec2 sceneSize = vec2(textureSize(sceneColour, 0));
+    vec2 position = clamp(UV * renderSize + jitter, vec2(0.5), renderSize - 0.5);
+    vec3 current = texture(sceneColour, position / sceneSize).rgb;
+
+    // Colour range and closest depth of the neighbouring rendered pixels
+    ivec2 centre = ivec2(position);
+    ivec2 last = ivec2(renderSize) - 1;
+    vec3 minimum = current;
+    vec3 maximum = current;
+    float depth = 1.0;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            ivec2 texel = clamp(centre + ivec2(x, y), ivec2(0), last);
+            vec3 colour = texelFetch(sceneColour, texel, 0).rgb;
+            minimum = min(minimum, colour);
+            maximum = max(maximum, colour);
+            depth = min(depth, texelFetch(sceneDepth, texel, 0).r);
+        }
+    }
+
+    // Reproject through the closest depth so silhouettes carry the foreground's motion
+    vec4 world = inverseViewProjection * vec4(2.0 * UV - 1.0, 2.0 * depth - 1.0, 1.0);
+    vec4 previous = previousViewProjection * vec4(world.xyz / world.w, 1.0);
+    vec2 previousUV = 0.5 * previous.xy / previous.w + 0.5;
+
+    // History from off screen or from before a reset is replaced by the current frame,
+    // otherwise it is limited to colours present around the pixel now
+    float alpha = blendFactor;
+    if (!historyValid || previous.w <= 0.0 || any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0))))
+        alpha = 1.0;
+    vec3 past = clamp(texture(history, previousUV).rgb, minimum, maximum);
+
+    fragmentColour = vec4(mix(past, current, alpha), 1.0);
+}
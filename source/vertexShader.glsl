@@ -8,6 +8,7 @@ layout(location = 1) in vec2 uv;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec3 tangent;
 layout(location = 4) in vec3 bitangent;
+layout(location = 5) in mat4 instanceModel;
 
 // Outputs
 out vec2 UV;
@@ -19,30 +20,51 @@ out vec3 tangentSpaceLightDirection[maxLights];
 struct Light
 {
     vec3 position;
-    vec3 colour;
-    vec3 direction;
     float constant;
+    vec3 colour;
     float linear;
+    vec3 direction;
     float quadratic;
     float cosPhi;
     int type;
 };
 
+// The depth pre-pass computes the same position, the main pass tests it with GL_EQUAL
+invariant gl_Position;
+
 // Uniforms
-uniform mat4 MVP;
-uniform mat4 MV;
-uniform Light lightSources[maxLights];
+layout(std140) uniform ObjectBlock
+{
+    mat4 MVP;
+    mat4 MV;
+};
+uniform mat4 V;
+uniform mat4 P;
+uniform bool instanced;
+layout(std140) uniform LightBlock
+{
+    Light lightSources[maxLights];
+};
 
 void main()
 {
+    // Instanced draws build the MV and MVP matrices from the per-instance model matrix
+    mat4 modelView = MV;
+    mat4 modelViewProjection = MVP;
+    if (instanced)
+    {
+        modelView = V * instanceModel;
+        modelViewProjection = P * modelView;
+    }
+    
     // Output vertex position
-    gl_Position = MVP * vec4(position, 1.0);
+    gl_Position = modelViewProjection * vec4(position, 1.0);
     
     // Output texture co-ordinates
     UV = uv;
     
     // Calculate the TBN matrix that transforms view space to tangent space
-    mat3 invMV = transpose(inverse(mat3(MV)));
+    mat3 invMV = transpose(inverse(mat3(modelView)));
     vec3 t     = normalize(invMV * tangent);
     //vec3 b     = normalize(invMV * bitangent);
     vec3 n     = normalize(invMV * normal);
@@ -51,10 +73,13 @@ void main()
     mat3 TBN   = transpose(mat3(t, b, n));
     
     // Output tangent space fragment position, light positions and directions
-    fragmentPosition = TBN * vec3(MV * vec4(position, 1.0));
+    fragmentPosition = TBN * vec3(modelView * vec4(position, 1.0));
     
+    // Lights are packed, the first unused slot ends the list
     for (int i = 0; i < maxLights; i++)
     {
+        if (lightSources[i].type == 0)
+            break;
         tangentSpaceLightPosition[i]  = TBN * lightSources[i].position;
         tangentSpaceLightDirection[i] = TBN * lightSources[i].direction;
     }
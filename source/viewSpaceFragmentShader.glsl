@@ -0,0 +1,201 @@
+#version 330 core
+
+# define maxLights 10
+# define maxShadowTiles 16
+# define numCascades 3
+# define maxMaterials 256
+
+// Inputs
+in vec2 UV;
+in vec3 fragmentPosition;
+in vec3 viewNormal;
+in vec3 viewTangent;
+flat in int materialIndex;
+
+// Outputs
+out vec3 fragmentColour;
+
+// Light struct
+struct Light
+{
+    vec3 position;
+    float constant;
+    vec3 colour;
+    float linear;
+    vec3 direction;
+    float quadratic;
+    float cosPhi;
+    int type;
+    int shadowTile;
+};
+
+// Uniforms
+uniform sampler2D diffuseMap;
+uniform sampler2D normalMap;
+uniform sampler2D specularMap;
+uniform float ka;
+uniform float kd;
+uniform float ks;
+uniform float Ns;
+
+// Material table, replaces the per-draw material uniforms when set
+struct Material
+{
+    vec4 tint;
+    float ka;
+    float kd;
+    float ks;
+    float Ns;
+    int diffuseLayer;
+    int normalLayer;
+    int specularLayer;
+};
+uniform bool useMaterialTable;
+uniform sampler2DArray materialLayers;
+layout(std140) uniform MaterialBlock
+{
+    Material materials[maxMaterials];
+};
+
+// Surface properties at the fragment
+struct Surface
+{
+    vec3 normal;
+    vec3 colour;
+    vec3 specularColour;
+    float ka;
+    float kd;
+    float ks;
+    float Ns;
+};
+layout(std140) uniform LightBlock
+{
+    Light lightSources[maxLights];
+};
+
+// Shadow atlases, cached static depth and this frame's dynamic objects
+uniform sampler2DShadow staticShadows;
+uniform sampler2DShadow dynamicShadows;
+layout(std140) uniform ShadowBlock
+{
+    mat4 shadowMatrices[maxShadowTiles];
+    vec4 shadowRects[maxShadowTiles];
+    mat4 viewToWorld;
+    vec4 cascadeSplits;
+};
+
+// Fraction of the light reaching the fragment, lit outside the light's tiles
+float shadow(Light source)
+{
+    if (source.shadowTile < 0)
+        return 1.0;
+    
+    // Directional lights pick the cascade by view depth, point lights the cube face by world direction
+    int tile = source.shadowTile;
+    if (source.type == 3)
+    {
+        int cascade = 0;
+        while (cascade < numCascades && -fragmentPosition.z > cascadeSplits[cascade])
+            cascade++;
+        if (cascade == numCascades)
+            return 1.0;
+        tile += cascade;
+    }
+    else if (source.type == 1)
+    {
+        vec3 d = mat3(viewToWorld) * (fragmentPosition - source.position);
+        vec3 a = abs(d);
+        if (a.x >= a.y && a.x >= a.z)
+            tile += d.x > 0.0 ? 0 : 1;
+        else if (a.y >= a.z)
+            tile += d.y > 0.0 ? 2 : 3;
+        else
+            tile += d.z > 0.0 ? 4 : 5;
+    }
+    
+    vec4 position = shadowMatrices[tile] * vec4(fragmentPosition, 1.0);
+    vec3 local = position.xyz / position.w;
+    if (position.w <= 0.0 || any(lessThan(local, vec3(0.0))) || any(greaterThan(local, vec3(1.0))))
+        return 1.0;
+    
+    // Keep the filtered lookup inside the tile
+    vec4 rect = shadowRects[tile];
+    vec3 coordinates = vec3(rect.xy + clamp(local.xy, rect.w, 1.0 - rect.w) * rect.z, local.z);
+    return min(texture(staticShadows, coordinates), texture(dynamicShadows, coordinates));
+}
+
+// Same lighting model as fragmentShader.glsl, in view space
+vec3 shade(Light source, Surface surface)
+{
+    vec3 light = source.type == 3 ? normalize(-source.direction) : normalize(source.position - fragmentPosition);
+    
+    // Ambient, diffuse and specular reflection
+    vec3 ambient    = surface.ka * surface.colour;
+    float cosTheta  = max(dot(surface.normal, light), 0);
+    vec3 diffuse    = surface.kd * source.colour * surface.colour * cosTheta;
+    vec3 reflection = - light + 2 * dot(light, surface.normal) * surface.normal;
+    vec3 camera     = normalize(-fragmentPosition);
+    float cosAlpha  = max(dot(camera, reflection), 0);
+    vec3 specular   = surface.ks * source.colour * pow(cosAlpha, surface.Ns) * surface.specularColour;
+    vec3 colour     = ambient + shadow(source) * (diffuse + specular);
+    
+    // Attenuation
+    if (source.type != 3)
+    {
+        float distance = length(source.position - fragmentPosition);
+        colour /= source.constant + source.linear * distance + source.quadratic * distance * distance;
+    }
+    
+    // Spotlight cone
+    if (source.type == 2)
+        colour *= clamp((dot(-light, normalize(source.direction)) - source.cosPhi) / radians(2.0), 0.0, 1.0);
+    return colour;
+}
+
+void main ()
+{
+    // Rebuild the tangent to view space matrix, a missing tangent is replaced by any perpendicular
+    vec3 n = normalize(viewNormal);
+    vec3 t = viewTangent;
+    if (dot(t, t) < 1e-8)
+        t = cross(n, abs(n.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0));
+    t = normalize(t - dot(t, n) * n);
+    mat3 TBN = mat3(t, cross(n, t), n);
+    
+    // Material from the table row or the per-draw uniforms
+    Surface surface;
+    vec3 tangentNormal;
+    if (useMaterialTable)
+    {
+        Material material      = materials[materialIndex];
+        surface.colour         = material.tint.rgb * vec3(texture(materialLayers, vec3(UV, material.diffuseLayer)));
+        surface.specularColour = vec3(texture(materialLayers, vec3(UV, material.specularLayer)));
+        tangentNormal          = vec3(texture(materialLayers, vec3(UV, material.normalLayer)));
+        surface.ka = material.ka;
+        surface.kd = material.kd;
+        surface.ks = material.ks;
+        surface.Ns = material.Ns;
+    }
+    else
+    {
+        surface.colour         = vec3(texture(diffuseMap, UV));
+        surface.specularColour = vec3(texture(specularMap, UV));
+        tangentNormal          = vec3(texture(normalMap, UV));
+        surface.ka = ka;
+        surface.kd = kd;
+        surface.ks = ks;
+        surface.Ns = Ns;
+    }
+    
+    // Perturb the normal with the normal map
+    surface.normal = normalize(TBN * normalize(2.0 * tangentNormal - 1.0));
+    
+    fragmentColour = vec3(0.0, 0.0, 0.0);
+    for (int i = 0; i < maxLights; i++)
+    {
+        // Lights are packed, the first unused slot ends the list
+        if (lightSources[i].type == 0)
+            break;
+        fragmentColour += shade(lightSources[i], surface);
+    }
+}
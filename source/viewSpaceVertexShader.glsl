@@ -0,0 +1,55 @@
+#version 330 core
+
+// Inputs
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec3 tangent;
+layout(location = 5) in mat4 instanceModel;
+layout(location = 9) in int material;
+
+// Outputs, the bitangent is rebuilt in the fragment shader so the
+// lights never have to be moved into tangent space per vertex
+out vec2 UV;
+out vec3 fragmentPosition;
+out vec3 viewNormal;
+out vec3 viewTangent;
+flat out int materialIndex;
+
+// The depth pre-pass computes the same position, the main pass tests it with GL_EQUAL
+invariant gl_Position;
+
+// Uniforms
+layout(std140) uniform ObjectBlock
+{
+    mat4 MVP;
+    mat4 MV;
+};
+uniform mat4 V;
+uniform mat4 P;
+uniform bool instanced;
+
+void main()
+{
+    // Instanced draws build the MV and MVP matrices from the per-instance model matrix
+    mat4 modelView = MV;
+    mat4 modelViewProjection = MVP;
+    if (instanced)
+    {
+        modelView = V * instanceModel;
+        modelViewProjection = P * modelView;
+    }
+    
+    // Output vertex position
+    gl_Position = modelViewProjection * vec4(position, 1.0);
+    
+    // Output texture co-ordinates and the material table row
+    UV = uv;
+    materialIndex = material;
+    
+    // Output view space position, normal and tangent
+    mat3 invMV       = transpose(inverse(mat3(modelView)));
+    fragmentPosition = vec3(modelView * vec4(position, 1.0));
+    viewNormal       = invMV * normal;
+    viewTangent      = invMV * tangent;
+}